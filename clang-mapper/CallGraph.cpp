@@ -3,19 +3,29 @@
 //
 
 #include "CallGraph.h"
+#include "FilterRules.h"
+#include "GraphArchive.h"
+#include "HtmlViewer.h"
 
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
-#include "clang/AST/StmtVisitor.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/ExprObjC.h"
+#include "clang/Basic/SourceManager.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/GraphWriter.h"
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <tuple>
 
 using namespace clang;
 using namespace llvm;
@@ -42,26 +52,47 @@ std::vector<std::string> split(const std::string &s, char delim) {
 namespace clang {
 /// A helper class, which walks the AST and locates all the call sites in the
 /// given function body.
-    class CGBuilder : public StmtVisitor<CGBuilder> {
+///
+/// The body is walked with an explicit stack rather than recursing once per
+/// AST level, deeply nested generated code would overflow the native stack.
+    class CGBuilder {
         CallGraph *G;
         CallGraphNode *CallerNode;
         ASTContext &Context;
-    public:
-        CGBuilder(CallGraph *g, CallGraphNode *N, ASTContext &context)
-                : G(g), CallerNode(N), Context(context) {}
 
-        void VisitStmt(Stmt *S) {
-            VisitChildren(S);
+        /// Statements left to visit, shared by all bodies of the graph
+        SmallVectorImpl<Stmt *> &Worklist;
+    public:
+        CGBuilder(CallGraph *g, CallGraphNode *N, ASTContext &context, SmallVectorImpl<Stmt *> &worklist)
+                : G(g), CallerNode(N), Context(context), Worklist(worklist) {}
+
+        /// Visit the statements of a body in pre-order, like a recursive walk
+        void Visit(Stmt *Body) {
+            Worklist.clear();
+            Worklist.push_back(Body);
+            while (!Worklist.empty()) {
+                Stmt *S = Worklist.pop_back_val();
+                if (CallExpr *CE = dyn_cast<CallExpr>(S)) {
+                    if (!VisitCallExpr(CE)) {
+                        continue;
+                    }
+                } else if (ObjCMessageExpr *ME = dyn_cast<ObjCMessageExpr>(S)) {
+                    VisitObjCMessageExpr(ME);
+                    continue;
+                }
+                pushChildren(S);
+            }
         }
 
-        void VisitCallExpr(CallExpr *CE) {
+        /// Return false if the children of the call are skipped
+        bool VisitCallExpr(CallExpr *CE) {
             if (Decl *D = getDeclFromCall(CE)) {
                 if (G->isInSystem(D)) {
-                    return;
+                    return false;
                 }
                 addCalledDecl(D);
             }
-            VisitChildren(CE);
+            return true;
         }
 
         // Adds may-call edges for the ObjC message sends.
@@ -81,7 +112,8 @@ namespace clang {
                     D = IDecl->lookupPrivateClassMethod(Sel);
                 }
 
-                // if not found, create a ObjCMethodDecl with Selector and loc
+                // if not found, create a ObjCMethodDecl with Selector and loc,
+                // in the context of the receiver so its class is still known
                 if (!D) {
                     D = ObjCMethodDecl::Create(Context,
                                                ME->getLocStart(),
@@ -89,7 +121,8 @@ namespace clang {
                                                ME->getSelector(),
                                                QualType(),
                                                nullptr,
-                                               nullptr);
+                                               IDecl,
+                                               ME->isInstanceMessage());
                 }
                 addCalledDecl(D);
             }
@@ -112,15 +145,23 @@ namespace clang {
         // add a callee node to caller node
         void addCalledDecl(Decl *D) {
             if (G->canIncludeInGraph(D)) {
-                CallGraphNode *CalleeNode = G->getOrInsertNode(D);
+                CallGraphNode *CalleeNode = G->getOrInsertFilteredNode(D);
+
+                // Skip dropped callees and the calls inside a collapsed group
+                if (!CalleeNode || (CalleeNode == CallerNode && CalleeNode->isGroup())) {
+                    return;
+                }
                 CallerNode->addCallee(CalleeNode);
             }
         }
 
-        void VisitChildren(Stmt *S) {
+        /// Push the children reversed, so the first child is visited first
+        void pushChildren(Stmt *S) {
+            size_t first = Worklist.size();
             for (Stmt *SubStmt : S->children())
                 if (SubStmt)
-                    this->Visit(SubStmt);
+                    Worklist.push_back(SubStmt);
+            std::reverse(Worklist.begin() + first, Worklist.end());
         }
     };
 
@@ -195,10 +236,14 @@ void CallGraph::addRootNode(Decl *decl) {
         decl = decl->getCanonicalDecl();
     }
 
-    CallGraphNode *Node = getOrInsertNode(decl);
+    // A dropped function doesn't bring its calls into the graph either
+    CallGraphNode *Node = getOrInsertFilteredNode(decl);
+    if (!Node) {
+        return;
+    }
 
     // Process all the calls by this function as well.
-    CGBuilder builder(this, Node, Context);
+    CGBuilder builder(this, Node, Context, Worklist);
     if (Stmt *Body = decl->getBody())
         builder.Visit(Body);
 }
@@ -218,16 +263,132 @@ CallGraphNode *CallGraph::getOrInsertNode(Decl *decl) {
     shared_ptr<CallGraphNode> &Node = Roots[decl];
     if (!Node) {
         Node = shared_ptr<CallGraphNode>(new CallGraphNode(decl));
+        Node->setID(Nodes.size());
+        Nodes.push_back(Node.get());
     }
     return Node.get();
 }
 
+/// Name of a declaration qualified by its class or namespace
+static std::string getQualifiedName(const Decl *D) {
+    if (const ObjCMethodDecl *decl = dyn_cast_or_null<ObjCMethodDecl>(D)) {
+        const ObjCInterfaceDecl *interface = decl->getDeclContext() ? decl->getClassInterface() : nullptr;
+        if (interface) {
+            return std::string(decl->isInstanceMethod() ? "-[" : "+[") +
+                   interface->getNameAsString() + " " + decl->getSelector().getAsString() + "]";
+        }
+        return decl->getSelector().getAsString();
+    } else if (const NamedDecl *decl = dyn_cast_or_null<NamedDecl>(D)) {
+        return decl->getQualifiedNameAsString();
+    }
+    return "";
+}
+
+/// Class of a method, empty for other declarations
+static std::string getClassName(const Decl *D) {
+    if (const ObjCMethodDecl *decl = dyn_cast<ObjCMethodDecl>(D)) {
+        const ObjCInterfaceDecl *interface = decl->getDeclContext() ? decl->getClassInterface() : nullptr;
+        if (interface) {
+            return interface->getNameAsString();
+        }
+    } else if (const CXXMethodDecl *decl = dyn_cast<CXXMethodDecl>(D)) {
+        return decl->getParent()->getQualifiedNameAsString();
+    }
+    return "";
+}
+
+CallGraphNode *CallGraph::getOrInsertFilteredNode(Decl *decl) {
+    if (!Filter) {
+        return getOrInsertNode(decl);
+    }
+    if (decl && !isa<ObjCMethodDecl>(decl)) {
+        decl = decl->getCanonicalDecl();
+    }
+
+    // Every declaration is matched once, however often it's called
+    auto cached = FilteredNodes.find(decl);
+    if (cached != FilteredNodes.end()) {
+        return cached->second;
+    }
+
+    // Unresolved sends get a method in the context of the receiver's
+    // interface but located at the call, the interface decides their folder
+    SourceLocation location = decl->getLocation();
+    if (isa<ObjCMethodDecl>(decl)) {
+        if (const ObjCInterfaceDecl *interface = dyn_cast_or_null<ObjCInterfaceDecl>(decl->getDeclContext())) {
+            location = interface->getLocation();
+        }
+    }
+
+    // Dir rules are absolute and normalized, the file name may be neither
+    SourceManager &SM = Context.getSourceManager();
+    SmallString<256> file(SM.getFilename(SM.getFileLoc(location)));
+    if (!file.empty()) {
+        sys::fs::make_absolute(file);
+        sys::path::remove_dots(file, true);
+    }
+    FilterRules::Match match = Filter->match(getQualifiedName(decl), getClassName(decl), file);
+
+    CallGraphNode *node = nullptr;
+    if (match.Act == FilterRules::Keep) {
+        node = getOrInsertNode(decl);
+    } else if (match.Act == FilterRules::Collapse) {
+        CallGraphNode *&group = Groups[match.Group];
+        if (!group) {
+            group = getOrInsertNode(decl);
+            group->setLabel(match.Group);
+        }
+        node = group;
+    }
+    FilteredNodes[decl] = node;
+    return node;
+}
+
+void CallGraph::sortNodes() {
+    struct SortKey {
+        std::string File;
+        unsigned Line;
+        unsigned Column;
+        std::string Name;
+        CallGraphNode *Node;
+    };
+
+    std::vector<SortKey> keys;
+    keys.reserve(Nodes.size());
+    for (CallGraphNode *node : Nodes) {
+        SortKey key = {"", 0, 0, node->getNameAsString(), node};
+        PresumedLoc PLoc = getNodeLocation(node);
+        if (PLoc.isValid()) {
+            key.File = PLoc.getFilename();
+            key.Line = PLoc.getLine();
+            key.Column = PLoc.getColumn();
+        }
+        keys.push_back(key);
+    }
+
+    // Nodes are appended in AST order, so a stable sort keeps ties deterministic
+    std::stable_sort(keys.begin(), keys.end(), [](const SortKey &lhs, const SortKey &rhs) {
+        return std::tie(lhs.File, lhs.Line, lhs.Column, lhs.Name) <
+               std::tie(rhs.File, rhs.Line, rhs.Column, rhs.Name);
+    });
+
+    for (unsigned i = 0; i < keys.size(); ++i) {
+        Nodes[i] = keys[i].Node;
+        Nodes[i]->setID(i);
+    }
+}
+
+PresumedLoc CallGraph::getNodeLocation(const CallGraphNode *node) const {
+    SourceManager &SM = Context.getSourceManager();
+    return SM.getPresumedLoc(SM.getFileLoc(node->getDecl()->getLocation()));
+}
+
 void CallGraph::print(raw_ostream &OS) const {
     OS << " --- Call graph Dump --- \n";
 
     // traversal root nodes
-    for (const_iterator it = this->begin(); it != Roots.end(); ++it) {
-        CallGraphNode *node = it->second.get();
+    for (const_iterator it = this->begin(); it != this->end(); ++it) {
+        CallGraphNode *node = *it;
         OS << "  Function: ";
         node->print(OS);
         OS << " calls: ";
@@ -264,6 +425,24 @@ void CallGraph::output() const {
         }
     }
 
+    // Put the .dot into the archive instead of a mirrored folder tree
+    if (Archive) {
+        string entryName;
+        for (; FI != fullComponent.end(); ++FI) {
+            if (!entryName.empty()) {
+                entryName.append("/");
+            }
+            entryName.append(*FI);
+        }
+        entryName.append(".dot");
+
+        std::string content;
+        raw_string_ostream O(content);
+        writeDot(O);
+        Archive->add(entryName, O.str());
+        return;
+    }
+
     string outputPath = "./";
     while (FI + 1 != fullComponent.end()) {
         outputPath.append(*FI);
@@ -274,6 +453,14 @@ void CallGraph::output() const {
         FI++;
     }
     outputPath.append(fullComponent.back());
+
+    if (Option == O_Html) {
+        outputPath.append(".html");
+        if (writeHtml(outputPath)) {
+            errs() << "Write to " << outputPath << "\n";
+        }
+        return;
+    }
     outputPath.append(".dot");
 
     // Write .dot
@@ -285,7 +472,7 @@ void CallGraph::output() const {
         return;
     }
 
-    llvm::WriteGraph(O, this);
+    writeDot(O);
     if (Option != O_GraphOnly) {
         errs() << "Write to " << outputPath << "\n";
     }
@@ -353,8 +540,38 @@ LLVM_DUMP_METHOD void CallGraphNode::dump() const {
     print(llvm::errs());
 }
 
+std::string CallGraphNode::getQualifiedNameAsString() const {
+    if (isGroup()) {
+        return Label;
+    }
+    std::string name = getQualifiedName(FD);
+    return name.empty() ? getNameAsString() : name;
+}
+
+const char *CallGraphNode::getKindName() const {
+    if (isGroup()) {
+        return "group";
+    } else if (ObjCMethodDecl *decl = dyn_cast_or_null<ObjCMethodDecl>(FD)) {
+        return decl->isInstanceMethod() ? "objc-instance-method" : "objc-class-method";
+    } else if (FD && isa<CXXMethodDecl>(FD)) {
+        return "method";
+    } else if (FD && isa<BlockDecl>(FD)) {
+        return "block";
+    }
+    return "function";
+}
+
+void CallGraphNode::getSortedCallees(SmallVectorImpl<CallGraphNode *> &callees) const {
+    callees.assign(begin(), end());
+    std::sort(callees.begin(), callees.end(), [](CallGraphNode *lhs, CallGraphNode *rhs) {
+        return lhs->getID() < rhs->getID();
+    });
+}
+
 std::string CallGraphNode::getNameAsString() const {
-    if (FunctionDecl *decl = dyn_cast_or_null<FunctionDecl>(FD)) {
+    if (isGroup()) {
+        return Label;
+    } else if (FunctionDecl *decl = dyn_cast_or_null<FunctionDecl>(FD)) {
         return decl->getNameAsString();
     } else if (ObjCMethodDecl *decl = dyn_cast_or_null<ObjCMethodDecl>(FD)) {
         return decl->getNameAsString();
@@ -371,7 +588,9 @@ namespace llvm {
 
         static std::string getNodeLabel(const CallGraphNode *Node,
                                         const CallGraph *CG) {
-            if (const NamedDecl *ND = dyn_cast_or_null<NamedDecl>(Node->getDecl()))
+            if (Node->isGroup())
+                return Node->getNameAsString();
+            else if (const NamedDecl *ND = dyn_cast_or_null<NamedDecl>(Node->getDecl()))
                 return ND->getNameAsString();
             else
                 return "< >";
@@ -386,3 +605,137 @@ namespace llvm {
         }
     };
 }
+
+std::string CallGraph::getRelativeFile(const Decl *D) const {
+    SourceManager &SM = Context.getSourceManager();
+    SmallString<256> file(SM.getFilename(SM.getFileLoc(D->getLocation())));
+    if (file.empty()) {
+        return "";
+    }
+    sys::fs::make_absolute(file);
+    sys::path::remove_dots(file, true);
+
+    StringRef path(file);
+    StringRef base = StringRef(BasePath).rtrim('/');
+    if (!base.empty() && path.startswith(base) && path.substr(base.size()).startswith("/")) {
+        path = path.substr(base.size() + 1);
+    }
+    return path.str();
+}
+
+std::string CallGraph::getSymbolName(const Decl *D) const {
+    std::string name = getQualifiedName(D);
+    const FunctionDecl *function = dyn_cast_or_null<FunctionDecl>(D);
+    if (function && !name.empty() && !function->isExternallyVisible()) {
+        return getRelativeFile(D) + ":" + name;
+    }
+    return name;
+}
+
+std::string CallGraph::getSymbolName(const CallGraphNode *node, StringMap<unsigned> &blocks) const {
+    if (node->isGroup()) {
+        return node->getQualifiedNameAsString();
+    }
+    const BlockDecl *block = dyn_cast_or_null<BlockDecl>(node->getDecl());
+    if (!block) {
+        return getSymbolName(node->getDecl());
+    }
+
+    // Blocks are numbered in source order inside the function declaring them
+    const DeclContext *context = block->getDeclContext();
+    while (context && isa<BlockDecl>(context)) {
+        context = context->getParent();
+    }
+    const Decl *parent = context ? cast<Decl>(context) : nullptr;
+    std::string enclosing = parent && !isa<TranslationUnitDecl>(parent) ? getSymbolName(parent) : "";
+    if (enclosing.empty()) {
+        enclosing = getRelativeFile(block);
+    }
+    return enclosing + "::block" + std::to_string(++blocks[enclosing]);
+}
+
+void CallGraph::writeDot(raw_ostream &O) const {
+    typedef DOTGraphTraits<const CallGraph*> Traits;
+
+    // Same layout as llvm::WriteGraph, which names nodes by their address
+    std::string graphName = DOT::EscapeString(Traits::getGraphName(this));
+    O << "digraph \"" << graphName << "\" {\n";
+    O << "\tlabel=\"" << graphName << "\";\n\n";
+
+    SmallVector<CallGraphNode *, 8> callees;
+    StringMap<unsigned> blocks;
+    for (const CallGraphNode *node : Nodes) {
+        // The label only has the short name, the tooltip identifies the symbol
+        // for diff and analyze
+        O << "\tNode" << node->getID() << " [shape=record,label=\"{"
+          << DOT::EscapeString(Traits::getNodeLabel(node, this)) << "}\"";
+        std::string symbol = getSymbolName(node, blocks);
+        if (!symbol.empty()) {
+            O << ",tooltip=\"" << DOT::EscapeString(symbol) << "\"";
+        }
+        O << "];\n";
+
+        node->getSortedCallees(callees);
+        for (CallGraphNode *callee : callees) {
+            O << "\tNode" << node->getID() << " -> Node" << callee->getID() << ";\n";
+        }
+    }
+    O << "}\n";
+}
+
+void CallGraph::writeNDJson(raw_ostream &OS) const {
+    std::string buffer;
+    raw_string_ostream O(buffer);
+
+    auto writeSymbol = [&](const CallGraphNode *node) {
+        PresumedLoc PLoc = getNodeLocation(node);
+        O << "{\"id\":" << node->getID() << ",\"symbol\":";
+        writeJSONString(O, node->getQualifiedNameAsString());
+        O << ",\"kind\":\"" << node->getKindName() << "\",\"file\":";
+        writeJSONString(O, PLoc.isValid() ? PLoc.getFilename() : "");
+        O << ",\"line\":" << (PLoc.isValid() ? PLoc.getLine() : 0) << "}";
+    };
+
+    for (const CallGraphNode *node : Nodes) {
+        O << "{\"type\":\"node\",\"tu\":";
+        writeJSONString(O, FullPath);
+        O << ",\"node\":";
+        writeSymbol(node);
+        O << "}\n";
+    }
+
+    SmallVector<CallGraphNode *, 8> callees;
+    for (const CallGraphNode *node : Nodes) {
+        node->getSortedCallees(callees);
+        for (const CallGraphNode *callee : callees) {
+            O << "{\"type\":\"edge\",\"tu\":";
+            writeJSONString(O, FullPath);
+            O << ",\"caller\":";
+            writeSymbol(node);
+            O << ",\"callee\":";
+            writeSymbol(callee);
+            O << "}\n";
+        }
+    }
+
+    OS << O.str();
+    OS.flush();
+}
+
+bool CallGraph::writeHtml(const std::string &path) const {
+    HtmlViewer viewer(split(FullPath, '/').back());
+    for (const CallGraphNode *node : Nodes) {
+        PresumedLoc PLoc = getNodeLocation(node);
+        viewer.addNode(node->getQualifiedNameAsString(), node->getKindName(),
+                       PLoc.isValid() ? PLoc.getFilename() : "", PLoc.isValid() ? PLoc.getLine() : 0);
+    }
+
+    SmallVector<CallGraphNode *, 8> callees;
+    for (const CallGraphNode *node : Nodes) {
+        node->getSortedCallees(callees);
+        for (const CallGraphNode *callee : callees) {
+            viewer.addEdge(node->getID(), callee->getID());
+        }
+    }
+    return viewer.write(path);
+}
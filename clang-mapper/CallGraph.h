@@ -10,6 +10,7 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringMap.h"
 #include <iostream>
 #include <algorithm>
 #include "CallGraphAction.h"
@@ -20,6 +21,8 @@ using namespace std;
 namespace clang {
     class CallGraphNode;
     class CallGraphAction;
+    class GraphArchiveWriter;
+    class FilterRules;
 
     class CallGraph : public RecursiveASTVisitor<CallGraph> {
         friend class CallGraphNode;
@@ -31,9 +34,28 @@ namespace clang {
         std::string BasePath;
         CallGraphOption Option;
 
+        /// Collects the .dot files instead of the file system if not null
+        GraphArchiveWriter *Archive = nullptr;
+
+        /// Drops or collapses symbols as they are added if not null
+        const FilterRules *Filter = nullptr;
+
+        /// Node of every declaration seen by the filter, null if dropped
+        llvm::DenseMap<const Decl *, CallGraphNode *> FilteredNodes;
+
+        /// Nodes standing for the collapsed symbols, by label
+        llvm::StringMap<CallGraphNode *> Groups;
+
         /// owns all caller node
         RootsMapType Roots;
 
+        /// All nodes, ordered by source location and then name after
+        /// sortNodes(). The position of a node is its ID in the output.
+        std::vector<CallGraphNode *> Nodes;
+
+        /// Work stack of the body walker, kept to reuse its memory for every body
+        SmallVector<Stmt *, 256> Worklist;
+
     public:
         CallGraph(ASTContext &context, std::string filePath, std::string basePath);
 
@@ -45,12 +67,25 @@ namespace clang {
         /// Recursively walks the declaration to find all the dependent Decls as well.
         void addToCallGraph(Decl *D) {
             TraverseDecl(D);
+            sortNodes();
         }
 
         void setOption(CallGraphOption option) {
             this->Option = option;
         }
 
+        CallGraphOption getOption() const {
+            return Option;
+        }
+
+        void setArchive(GraphArchiveWriter *archive) {
+            this->Archive = archive;
+        }
+
+        void setFilter(const FilterRules *filter) {
+            this->Filter = filter;
+        }
+
         /// \brief Determine if a declaration should be included in the graph.
         static bool canIncludeInGraph(const Decl *D);
 
@@ -64,20 +99,24 @@ namespace clang {
         /// one into the graph.
         CallGraphNode *getOrInsertNode(Decl *);
 
+        /// \brief Like getOrInsertNode(), but applies the filter rules: return
+        /// null for a dropped declaration, and the group node for a collapsed one.
+        CallGraphNode *getOrInsertFilteredNode(Decl *);
+
 //        void insertNode(Decl *);
 
-        /// Iterators through all the elements in the graph. Note, this gives
-        /// non-deterministic order.
-        typedef RootsMapType::iterator iterator;
-        typedef RootsMapType::const_iterator const_iterator;
+        /// Iterators through all the nodes in the graph, ordered by source
+        /// location and then name, so identical inputs give identical output.
+        typedef std::vector<CallGraphNode *>::iterator iterator;
+        typedef std::vector<CallGraphNode *>::const_iterator const_iterator;
 
-        iterator begin() { return Roots.begin(); }
-        iterator end() { return Roots.end(); }
-        const_iterator begin() const { return Roots.begin(); }
-        const_iterator end() const { return Roots.end(); }
+        iterator begin() { return Nodes.begin(); }
+        iterator end() { return Nodes.end(); }
+        const_iterator begin() const { return Nodes.begin(); }
+        const_iterator end() const { return Nodes.end(); }
 
-        /// \brief Get the number of root nodes in the graph.
-        unsigned size() const { return Roots.size(); }
+        /// \brief Get the number of nodes in the graph.
+        unsigned size() const { return Nodes.size(); }
 
         /// Iterators through all the nodes of the graph that have no parent. These
         /// are the unreachable nodes, which are either unused or are due to us
@@ -92,6 +131,19 @@ namespace clang {
         void print(raw_ostream &os) const;
         void dump() const;
         void output() const;
+
+        /// \brief Write the graph in dot format, using the node IDs instead of
+        /// addresses so the file only depends on the source.
+        void writeDot(raw_ostream &os) const;
+
+        /// \brief Write one JSON object per node and per edge, each on its own line.
+        ///
+        /// The records of the whole translation unit are written with a single
+        /// write, so the output of concurrent processes doesn't interleave.
+        void writeNDJson(raw_ostream &os) const;
+
+        /// \brief Write an html viewer of the graph to `path`, see HtmlViewer.
+        bool writeHtml(const std::string &path) const;
         bool generateGraphFile(std::string dotFile) const;
 
         /// Part of recursive declaration visitation. We recursively visit all the
@@ -141,6 +193,25 @@ namespace clang {
     private:
         /// Add a root node to call graph
         void addRootNode(Decl *decl);
+
+        /// Order the nodes by source location and name, and number them
+        void sortNodes();
+
+        /// Location of the declaration of a node, invalid for implicit decls
+        PresumedLoc getNodeLocation(const CallGraphNode *node) const;
+
+        /// Path of the file declaring `D`, relative to the base path so it's
+        /// the same for every checkout
+        std::string getRelativeFile(const Decl *D) const;
+
+        /// \brief Name identifying a declaration across files: the qualified
+        /// name, prefixed with the file for functions with internal linkage.
+        std::string getSymbolName(const Decl *D) const;
+
+        /// \brief Like getSymbolName(), and name blocks by their enclosing
+        /// function and position, counted in `blocks`. Nodes must be visited
+        /// in order.
+        std::string getSymbolName(const CallGraphNode *node, llvm::StringMap<unsigned> &blocks) const;
     };
 
     class CallGraphNode {
@@ -151,11 +222,17 @@ namespace clang {
         /// \brief The function/method declaration.
         Decl *FD;
 
+        /// \brief Stable position of this node in the graph, see CallGraph::sortNodes()
+        unsigned ID;
+
         /// \brief The list of functions called from this node.
         SmallVector<CallRecord, 5> CalledFunctions;
 
+        /// \brief Name of a node standing for several collapsed symbols, empty otherwise.
+        std::string Label;
+
     public:
-        CallGraphNode(Decl *D) : FD(D) {}
+        CallGraphNode(Decl *D) : FD(D), ID(0) {}
 
         typedef SmallVectorImpl<CallRecord>::iterator iterator;
         typedef SmallVectorImpl<CallRecord>::const_iterator const_iterator;
@@ -185,10 +262,27 @@ namespace clang {
 
         Decl *getDecl() const { return FD; }
 
+        unsigned getID() const { return ID; }
+        void setID(unsigned id) { ID = id; }
+
+        void setLabel(StringRef label) { Label = label.str(); }
+        bool isGroup() const { return !Label.empty(); }
+
         void print(raw_ostream &os) const;
         void dump() const;
 
         std::string getNameAsString() const;
+
+        /// \brief Name qualified by its class or namespace, `-[Class selector]`
+        /// for Objective-C methods.
+        std::string getQualifiedNameAsString() const;
+
+        /// \brief Kind of the declaration: function, method, objc-instance-method,
+        /// objc-class-method, block, or group for collapsed symbols.
+        const char *getKindName() const;
+
+        /// \brief Get the callees ordered by their ID.
+        void getSortedCallees(SmallVectorImpl<CallGraphNode *> &callees) const;
     };
 
 } // end clang namespace
@@ -217,20 +311,14 @@ namespace llvm {
 
     template <> struct GraphTraits<clang::CallGraph*>
             : public GraphTraits<clang::CallGraphNode*> {
-        static clang::CallGraphNode *
-        CGGetValue(clang::CallGraph::const_iterator::value_type &P) {
-            return P.second.get();
-        }
-
         // nodes_iterator/begin/end - Allow iteration over all nodes in the graph
-        typedef mapped_iterator<clang::CallGraph::iterator, decltype(&CGGetValue)>
-                nodes_iterator;
+        typedef clang::CallGraph::iterator nodes_iterator;
 
         static nodes_iterator nodes_begin (clang::CallGraph *CG) {
-            return nodes_iterator(CG->begin(), &CGGetValue);
+            return CG->begin();
         }
         static nodes_iterator nodes_end (clang::CallGraph *CG) {
-            return nodes_iterator(CG->end(), &CGGetValue);
+            return CG->end();
         }
 
         static unsigned size(clang::CallGraph *CG) {
@@ -240,22 +328,15 @@ namespace llvm {
 
     template <> struct GraphTraits<const clang::CallGraph*> :
             public GraphTraits<const clang::CallGraphNode*> {
-        static clang::CallGraphNode *
-        CGGetValue(clang::CallGraph::const_iterator::value_type &P) {
-            return P.second.get();
-        }
-
         // nodes_iterator/begin/end - Allow iteration over all nodes in the graph
-        typedef mapped_iterator<clang::CallGraph::const_iterator,
-                decltype(&CGGetValue)>
-                nodes_iterator;
+        typedef clang::CallGraph::const_iterator nodes_iterator;
 
         static nodes_iterator nodes_begin(const clang::CallGraph *CG) {
-            return nodes_iterator(CG->begin(), &CGGetValue);
+            return CG->begin();
         }
 
         static nodes_iterator nodes_end(const clang::CallGraph *CG) {
-            return nodes_iterator(CG->end(), &CGGetValue);
+            return CG->end();
         }
 
         static unsigned size(const clang::CallGraph *CG) {
@@ -4,26 +4,56 @@
 
 #include "CallGraphAction.h"
 #include "CallGraph.h"
+#include "TimingDatabase.h"
+#include "TokenIndex.h"
+
+typedef std::chrono::duration<double, std::milli> Milliseconds;
 
 void CallGraphConsumer::HandleTranslationUnit(clang::ASTContext &Context) {
     visitor->addToCallGraph(Context.getTranslationUnitDecl());
-    visitor->dump();
-    visitor->output();
+    auto parsed = std::chrono::steady_clock::now();
+
+    if (Focus) {
+        for (CallGraphNode *node : *visitor) {
+            for (CallGraphNode *callee : *node) {
+                Focus->addCall(node->getNameAsString(), callee->getNameAsString());
+            }
+        }
+    }
+
+    if (visitor->getOption() == O_NDJson) {
+        visitor->writeNDJson(llvm::outs());
+    } else {
+        visitor->dump();
+        visitor->output();
+    }
+
+    if (Timings) {
+        auto rendered = std::chrono::steady_clock::now();
+        Timings->record(Filename, Milliseconds(parsed - Created).count(),
+                        Milliseconds(rendered - parsed).count());
+    }
 }
 
-CallGraphConsumer::CallGraphConsumer(CompilerInstance &CI, std::string filename, std::string basePath, CallGraphOption option) {
+CallGraphConsumer::CallGraphConsumer(CompilerInstance &CI, std::string filename, std::string basePath,
+                                     CallGraphOption option, TimingDatabase *timings,
+                                     GraphArchiveWriter *archive, const FilterRules *filter,
+                                     FocusGraph *focus)
+        : Filename(filename), Timings(timings), Focus(focus), Created(std::chrono::steady_clock::now()) {
         this->visitor = new CallGraph(CI.getASTContext(), filename, basePath);
         this->visitor->setOption(option);
+        this->visitor->setArchive(archive);
+        this->visitor->setFilter(filter);
 }
 
 std::unique_ptr<clang::ASTConsumer> CallGraphAction::CreateASTConsumer(
         clang::CompilerInstance &Compiler, llvm::StringRef InFile) {
     Compiler.getDiagnostics().setClient(new IgnoringDiagConsumer());
-    return std::unique_ptr<clang::ASTConsumer>(new CallGraphConsumer(Compiler, InFile, BasePath, option));
+    return std::unique_ptr<clang::ASTConsumer>(new CallGraphConsumer(Compiler, InFile, BasePath, option, Timings, Archive, Filter, Focus));
 }
 
 std::unique_ptr<ASTConsumer> CallGraphAction::newASTConsumer(clang::CompilerInstance &CI, StringRef InFile) {
     llvm::errs() << "Scan " << InFile << "\n";
     CI.getDiagnostics().setClient(new IgnoringDiagConsumer());
-    return llvm::make_unique<CallGraphConsumer>(CI, InFile, BasePath, option);
+    return llvm::make_unique<CallGraphConsumer>(CI, InFile, BasePath, option, Timings, Archive, Filter, Focus);
 }
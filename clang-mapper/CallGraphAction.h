@@ -11,6 +11,7 @@
 #include <clang/AST/RecursiveASTVisitor.h>
 #include <clang/AST/ASTConsumer.h>
 #include <llvm/Support/Casting.h>
+#include <chrono>
 #include <iostream>
 #include "Commons.h"
 
@@ -21,19 +22,40 @@ namespace clang {
     class CallGraph;
     class CallGraphAction;
     class CallGraphConsumer;
+    class TimingDatabase;
+    class GraphArchiveWriter;
+    class FilterRules;
+    class FocusGraph;
 
     class CallGraphConsumer : public clang::ASTConsumer {
     public:
-        explicit CallGraphConsumer(CompilerInstance &CI, std::string filename, std::string basePath, CallGraphOption option);
+        explicit CallGraphConsumer(CompilerInstance &CI, std::string filename, std::string basePath,
+                                   CallGraphOption option, TimingDatabase *timings,
+                                   GraphArchiveWriter *archive, const FilterRules *filter,
+                                   FocusGraph *focus);
         virtual void HandleTranslationUnit(clang::ASTContext &Context);
     private:
         CallGraph *visitor;
+        std::string Filename;
+
+        /// Records parse and render durations if not null
+        TimingDatabase *Timings;
+
+        /// Collects the calls of the file by name for -focus if not null
+        FocusGraph *Focus;
+
+        /// The consumer is created right before parsing starts
+        std::chrono::steady_clock::time_point Created;
     };
 
     class CallGraphAction : public clang::ASTFrontendAction {
     private:
         CallGraphOption option;
         std::string BasePath;
+        TimingDatabase *Timings = nullptr;
+        GraphArchiveWriter *Archive = nullptr;
+        const FilterRules *Filter = nullptr;
+        FocusGraph *Focus = nullptr;
     public:
         virtual std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(
                 clang::CompilerInstance &Compiler, llvm::StringRef InFile);
@@ -46,6 +68,22 @@ namespace clang {
             this->BasePath = basePath;
         }
 
+        void setTimingDatabase(TimingDatabase *timings) {
+            this->Timings = timings;
+        }
+
+        void setArchive(GraphArchiveWriter *archive) {
+            this->Archive = archive;
+        }
+
+        void setFilter(const FilterRules *filter) {
+            this->Filter = filter;
+        }
+
+        void setFocusGraph(FocusGraph *focus) {
+            this->Focus = focus;
+        }
+
         std::unique_ptr<ASTConsumer> newASTConsumer(clang::CompilerInstance &CI, StringRef InFile);
     };
 }
@@ -6,9 +6,20 @@
 #include "clang/Driver/Options.h"
 #include "llvm/Support/FileSystem.h"
 #include "CallGraphAction.h"
+#include "FileCache.h"
+#include "FilterRules.h"
+#include "GraphAnalysis.h"
+#include "GraphArchive.h"
+#include "GraphDiff.h"
+#include "TimingDatabase.h"
+#include "TokenIndex.h"
+#include "WorkerPool.h"
 #include <sstream>
 #include <limits.h>
 #include <stdlib.h>
+#include <set>
+#include <algorithm>
+#include <thread>
 #include "Commons.h"
 
 using namespace std;
@@ -26,8 +37,52 @@ static cl::opt<bool>
         GraphOnly("graph-only", cl::desc("Generate graph file only"), cl::cat(MyToolCategory));
 static cl::opt<bool>
         DotAndGraph("dot-graph", cl::desc("Generate both dot and graph file"), cl::cat(MyToolCategory));
+static cl::opt<bool>
+        NDJson("ndjson", cl::desc("Write nodes and edges to stdout as newline delimited JSON, no files"),
+               cl::cat(MyToolCategory));
+static cl::opt<bool>
+        Html("html", cl::desc("Generate an html viewer which loads the calls on demand, for large graphs"),
+             cl::cat(MyToolCategory));
 static cl::opt<bool>
         IgnoreHeader("ignore-header", cl::desc("Ignore header file in the directory"), cl::cat(MyToolCategory));
+static cl::opt<bool>
+        Isolate("isolate", cl::desc("Process every file in a separate worker process"), cl::cat(MyToolCategory));
+static cl::opt<unsigned>
+        Jobs("j", cl::desc("Number of worker processes with -isolate, or of file readahead threads "
+                           "otherwise, default is the number of cores"),
+             cl::init(0), cl::cat(MyToolCategory));
+static cl::opt<unsigned>
+        TUTimeout("tu-timeout", cl::desc("Seconds a worker may spend on one file with -isolate, 0 for no limit"),
+                  cl::init(0), cl::cat(MyToolCategory));
+static cl::opt<unsigned>
+        TUMemory("tu-memory", cl::desc("Memory limit of a worker in MB with -isolate, 0 for no limit"),
+                 cl::init(0), cl::cat(MyToolCategory));
+static cl::opt<unsigned>
+        FileCacheSize("file-cache", cl::desc("Memory for sharing file contents between files in MB, 0 to disable"),
+                      cl::init(512), cl::cat(MyToolCategory));
+static cl::opt<std::string>
+        ArchivePath("archive", cl::desc("Write all dot files into one archive file instead of a folder tree"),
+                    cl::value_desc("file"), cl::cat(MyToolCategory));
+static cl::opt<std::string>
+        RulesPath("rules", cl::desc("Drop or collapse the symbols matching the rules in the file"),
+                  cl::value_desc("file"), cl::cat(MyToolCategory));
+static cl::opt<std::string>
+        Focus("focus", cl::desc("Only parse the files around this function or selector"),
+              cl::value_desc("symbol"), cl::cat(MyToolCategory));
+static cl::opt<unsigned>
+        FocusDepth("focus-depth", cl::desc("Calls to follow from the -focus symbol, default is 1"),
+                   cl::init(1), cl::cat(MyToolCategory));
+static cl::opt<std::string>
+        BasePath("base-path", cl::desc("Folder the output paths are relative to"), cl::Hidden, cl::cat(MyToolCategory));
+static cl::opt<std::string>
+        TimingOut("timing-out", cl::desc("Write the timings of this run to the file instead of the database"),
+                  cl::Hidden, cl::cat(MyToolCategory));
+
+/// Parse and render time of every file, used by -isolate to start the slowest files first
+static const char *TimingFile = ".clang-mapper-timings";
+
+/// Identifiers of every file, used by -focus to pick the files to parse
+static const char *IndexFile = ".clang-mapper-index";
 
 /// Specification `newFrontendActionFactory`
 template <>
@@ -128,7 +183,135 @@ void getFilesInDir(string rootDir, vector<string> &files, bool ignoreHeader) {
     }
 }
 
+unsigned getJobs() {
+    return Jobs ? Jobs : std::max(1u, std::thread::hardware_concurrency());
+}
+
+/// Run every source file in a worker process, forwarding all other arguments
+int runIsolated(const vector<string> &commands, const vector<string> &sources, string basePath,
+                clang::TimingDatabase &timings, clang::GraphArchiveWriter *archive) {
+    set<string> sourceSet(sources.begin(), sources.end());
+    vector<string> workerArgs;
+    workerArgs.push_back("-base-path=" + basePath);
+
+    // A worker parses a single file, a cache and readahead pool per worker
+    // would only multiply the memory and threads
+    workerArgs.push_back("-file-cache=0");
+
+    // Options only the parent handles, in both the `-opt=value` and the
+    // `-opt value` spelling. The workers get their own -archive and -timing-out
+    static const char *const valueOptions[] = {
+            "j", "tu-timeout", "tu-memory", "base-path", "timing-out", "archive", "file-cache",
+    };
+
+    size_t fileArgIndex = string::npos;
+    for (vector<string>::size_type i = 1; i < commands.size(); ++i) {
+        StringRef arg(commands[i]);
+        if (fileArgIndex == string::npos) {
+            if (arg == "--") {
+                fileArgIndex = workerArgs.size();
+            } else if (sourceSet.count(commands[i])) {
+                continue;
+            } else if (arg.startswith("-")) {
+                std::pair<StringRef, StringRef> option = arg.ltrim('-').split('=');
+                if (option.first == "isolate") {
+                    continue;
+                }
+                if (std::find(std::begin(valueOptions), std::end(valueOptions), option.first) !=
+                    std::end(valueOptions)) {
+                    if (arg.find('=') == StringRef::npos) {
+                        ++i; // the value is the next argument
+                    }
+                    continue;
+                }
+            }
+        }
+        workerArgs.push_back(commands[i]);
+    }
+    if (fileArgIndex == string::npos) {
+        fileArgIndex = workerArgs.size();
+    }
+
+    string executable = sys::fs::getMainExecutable(commands[0].c_str(), (void *)&getAbsolutePath);
+    clang::WorkerPool pool(executable, workerArgs, fileArgIndex, getJobs());
+    pool.setTimeout(TUTimeout);
+    pool.setMemoryLimit(TUMemory);
+    pool.setTimingDatabase(&timings);
+    pool.setCaptureOutput(NDJson);
+    pool.setArchive(archive);
+
+    // Start the slowest files first, so a long file doesn't run alone at the end
+    vector<string> queue(sources);
+    timings.sortLongestFirst(queue);
+    if (!pool.run(queue)) {
+        pool.writeFailures("clang-mapper-failures.txt");
+        llvm::errs() << pool.failures().size() << " files failed, see clang-mapper-failures.txt\n";
+    }
+    timings.save(TimingFile);
+    return 0;
+}
+
+/// Parse the files mentioning the -focus symbol, then the files mentioning
+/// its callers and callees found so far, for -focus-depth rounds
+void runFocused(const CompilationDatabase &compilations, const vector<string> &sources,
+                IntrusiveRefCntPtr<vfs::FileSystem> fileSystem, clang::CachingFileSystem *fileCache,
+                clang::CallGraphAction &action) {
+    clang::TokenIndex index;
+    index.load(IndexFile);
+    index.update(sources, getJobs());
+    index.save(IndexFile);
+
+    clang::FocusGraph graph;
+    action.setFocusGraph(&graph);
+
+    // The graph knows symbols by the name of their declaration only
+    string name = clang::FocusGraph::getName(Focus);
+    StringSet<> known;
+    known.insert(name);
+    vector<string> symbols(1, name);
+    set<string> parsed;
+    for (unsigned depth = 0; !symbols.empty(); ++depth) {
+        vector<string> files;
+        for (const string &symbol : symbols) {
+            for (const string &file : index.filesMentioning(symbol)) {
+                if (parsed.insert(file).second) {
+                    files.push_back(file);
+                }
+            }
+        }
+        llvm::errs() << "Focus depth " << depth << ": " << symbols.size() << " symbols in "
+                     << files.size() << " new files\n";
+
+        if (!files.empty()) {
+            if (fileCache) {
+                fileCache->readahead(files, getJobs());
+            }
+            ClangTool Tool(compilations, files, std::make_shared<PCHContainerOperations>(), fileSystem);
+            Tool.run(newFrontendActionFactory(&action).get());
+        }
+        if (depth == FocusDepth) {
+            break;
+        }
+        symbols = graph.expand(symbols, known);
+    }
+
+    if (parsed.empty()) {
+        llvm::errs() << "Error: no file mentions " << Focus << "\n";
+    }
+}
+
 int main(int argc, const char **argv) {
+    // subcommands working on saved graphs
+    if (argc > 1 && strcmp("diff", argv[1]) == 0) {
+        return clang::runDiffCommand(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp("analyze", argv[1]) == 0) {
+        return clang::runAnalyzeCommand(argc - 2, argv + 2);
+    }
+    if (argc > 1 && strcmp("archive", argv[1]) == 0) {
+        return clang::runArchiveCommand(argc - 2, argv + 2);
+    }
+
     // recursive get all files in directory path arg
     bool ignoreHeader = false;
     for (int i = 0; i < argc; i++) {
@@ -160,18 +343,88 @@ int main(int argc, const char **argv) {
     argc = commands.size();
 
     CommonOptionsParser OptionsParser(argc, argList, MyToolCategory);
-    ClangTool Tool(OptionsParser.getCompilations(), OptionsParser.getSourcePathList());
+    string basePath = BasePath.empty() ? getAbsolutePath(outputRootPath) : BasePath;
+
+    // A worker of -isolate only reports the timing of its own file, the
+    // supervisor merges it into the database.
+    clang::TimingDatabase timings;
+    if (TimingOut.empty()) {
+        timings.load(TimingFile);
+    }
+
+    // Files are parsed one by one in process, keep their order independent
+    // of the timings so the output is the same for every run
+    vector<string> sources = OptionsParser.getSourcePathList();
+    std::sort(sources.begin(), sources.end());
+
+    // Workers of -isolate load the rules themselves, this only checks them
+    clang::FilterRules rules;
+    if (!RulesPath.empty() && !rules.load(RulesPath, basePath)) {
+        return 1;
+    }
+
+    // The archive only holds .dot files, the viewer needs its own folder
+    if (Html && !ArchivePath.empty()) {
+        llvm::errs() << "Error: -html can't be used with -archive\n";
+        return 1;
+    }
+
+    clang::GraphArchiveWriter archive;
+    if (!ArchivePath.empty() && !archive.open(ArchivePath)) {
+        return 1;
+    }
+
+    // -focus picks the files round by round, it always runs in process
+    if (Isolate && Focus.empty()) {
+        return runIsolated(commands, sources, basePath, timings,
+                           archive.isOpen() ? &archive : nullptr);
+    }
+
+    // Every file reads the same project headers, share their contents and
+    // load them ahead of the parser
+    IntrusiveRefCntPtr<vfs::FileSystem> fileSystem = vfs::getRealFileSystem();
+    IntrusiveRefCntPtr<clang::CachingFileSystem> fileCache;
+    if (FileCacheSize) {
+        fileCache = new clang::CachingFileSystem(fileSystem, (uint64_t)FileCacheSize << 20);
+        if (Focus.empty()) {
+            fileCache->readahead(sources, getJobs());
+        }
+        fileSystem = fileCache;
+    }
 
     clang::CallGraphAction action;
-    action.setBasePath(getAbsolutePath(outputRootPath));
+    action.setBasePath(basePath);
     if (DotOnly) {
         action.setOption(O_DotOnly);
     } else if (DotAndGraph) {
         action.setOption(O_DotAndGraph);
+    } else if (NDJson) {
+        action.setOption(O_NDJson);
+    } else if (Html) {
+        action.setOption(O_Html);
     } else {
         action.setOption(O_GraphOnly);
     }
 
-    Tool.run(newFrontendActionFactory(&action).get());
+    action.setTimingDatabase(&timings);
+    if (archive.isOpen()) {
+        action.setArchive(&archive);
+    }
+    if (!rules.empty()) {
+        action.setFilter(&rules);
+    }
+
+    if (!Focus.empty()) {
+        runFocused(OptionsParser.getCompilations(), sources, fileSystem, fileCache.get(), action);
+    } else {
+        ClangTool Tool(OptionsParser.getCompilations(), sources,
+                       std::make_shared<PCHContainerOperations>(), fileSystem);
+        Tool.run(newFrontendActionFactory(&action).get());
+    }
+    archive.close();
+    if (fileCache) {
+        fileCache->printStatistics(llvm::errs());
+    }
+    timings.save(TimingOut.empty() ? TimingFile : TimingOut);
     return 0;
 }
@@ -5,6 +5,10 @@
 #ifndef LIBTOOLING_COMMONS_H
 #define LIBTOOLING_COMMONS_H
 
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
 enum CallGraphOption: unsigned {
     /// Only generate graph file
     O_GraphOnly = 0,
@@ -13,7 +17,32 @@ enum CallGraphOption: unsigned {
     O_DotOnly,
 
     /// Generate both dot and graph file
-    O_DotAndGraph
+    O_DotAndGraph,
+
+    /// Write nodes and edges to stdout as newline delimited JSON, no files
+    O_NDJson,
+
+    /// Generate an html viewer, no dot or graph file
+    O_Html
 };
 
+/// Write `str` as a quoted JSON string
+inline void writeJSONString(llvm::raw_ostream &O, llvm::StringRef str) {
+    O << '"';
+    for (unsigned char c : str) {
+        if (c == '"' || c == '\\') {
+            O << '\\' << c;
+        } else if (c == '\n') {
+            O << "\\n";
+        } else if (c == '\t') {
+            O << "\\t";
+        } else if (c < 0x20) {
+            O << llvm::format("\\u%04x", c);
+        } else {
+            O << c;
+        }
+    }
+    O << '"';
+}
+
 #endif //LIBTOOLING_COMMONS_H
@@ -0,0 +1,205 @@
+#include "FileCache.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+
+using namespace clang;
+using namespace llvm;
+
+/// How many levels of quoted includes readahead follows
+static const unsigned ReadaheadDepth = 2;
+
+/// A file served from the cache. The buffer stays owned by the cache, which
+/// lives as long as the tool.
+class CachingFileSystem::CachedFileHandle : public vfs::File {
+public:
+    CachedFileHandle(std::shared_ptr<CachedFile> file, std::string name)
+            : File(std::move(file)), Name(std::move(name)) {}
+
+    ErrorOr<vfs::Status> status() override {
+        return vfs::Status::copyWithNewName(File->Status, Name);
+    }
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>> getBuffer(const Twine &Name, int64_t FileSize,
+                                                     bool RequiresNullTerminator,
+                                                     bool IsVolatile) override {
+        return MemoryBuffer::getMemBuffer(File->Buffer->getBuffer(), Name.str(), RequiresNullTerminator);
+    }
+
+    std::error_code close() override {
+        return std::error_code();
+    }
+
+private:
+    std::shared_ptr<CachedFile> File;
+    std::string Name;
+};
+
+CachingFileSystem::CachingFileSystem(IntrusiveRefCntPtr<vfs::FileSystem> base, uint64_t capacity)
+        : Base(base), Capacity(capacity), Size(0), Hits(0), Misses(0) {}
+
+CachingFileSystem::~CachingFileSystem() {
+    if (Readahead) {
+        Readahead->wait();
+    }
+}
+
+ErrorOr<vfs::Status> CachingFileSystem::status(const Twine &Path) {
+    std::string path = Path.str();
+    if (std::shared_ptr<CachedFile> file = lookup(getKey(path))) {
+        return vfs::Status::copyWithNewName(file->Status, path);
+    }
+    return Base->status(path);
+}
+
+ErrorOr<std::unique_ptr<vfs::File>> CachingFileSystem::openFileForRead(const Twine &Path) {
+    std::string path = Path.str();
+    std::string key = getKey(path);
+    std::shared_ptr<CachedFile> file = lookup(key);
+    if (file) {
+        ++Hits;
+    } else {
+        ++Misses;
+        file = load(key);
+    }
+
+    if (!file) {
+        return Base->openFileForRead(path);
+    }
+    return std::unique_ptr<vfs::File>(new CachedFileHandle(file, path));
+}
+
+vfs::directory_iterator CachingFileSystem::dir_begin(const Twine &Dir, std::error_code &EC) {
+    return Base->dir_begin(Dir, EC);
+}
+
+ErrorOr<std::string> CachingFileSystem::getCurrentWorkingDirectory() const {
+    return Base->getCurrentWorkingDirectory();
+}
+
+std::error_code CachingFileSystem::setCurrentWorkingDirectory(const Twine &Path) {
+    return Base->setCurrentWorkingDirectory(Path);
+}
+
+std::string CachingFileSystem::getKey(StringRef path) const {
+    // ClangTool changes the working directory for every compile command, so
+    // relative paths only name the same file once they are made absolute
+    SmallString<256> key(path);
+    if (!sys::path::is_absolute(key)) {
+        ErrorOr<std::string> directory = Base->getCurrentWorkingDirectory();
+        if (directory) {
+            sys::fs::make_absolute(*directory, key);
+        }
+    }
+    sys::path::remove_dots(key, true);
+    return key.str().str();
+}
+
+std::shared_ptr<CachingFileSystem::CachedFile> CachingFileSystem::lookup(StringRef key) const {
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto it = Files.find(key);
+    return it == Files.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<CachingFileSystem::CachedFile> CachingFileSystem::load(StringRef key) {
+    ErrorOr<vfs::Status> status = Base->status(key);
+    if (!status || !status->isRegularFile()) {
+        return nullptr;
+    }
+
+    // Reserve the space before reading, so the readahead threads can't all
+    // pass the check together and go over the capacity
+    uint64_t reserved = status->getSize();
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (Size + reserved > Capacity) {
+            return nullptr;
+        }
+        Size += reserved;
+    }
+    auto release = [this, reserved] {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Size -= reserved;
+    };
+
+    ErrorOr<std::unique_ptr<vfs::File>> handle = Base->openFileForRead(key);
+    if (!handle) {
+        release();
+        return nullptr;
+    }
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = (*handle)->getBuffer(key, status->getSize());
+    if (!buffer) {
+        release();
+        return nullptr;
+    }
+
+    std::shared_ptr<CachedFile> file = std::make_shared<CachedFile>();
+    file->Status = *status;
+    file->Buffer = std::move(*buffer);
+
+    // Another thread may have loaded it meanwhile, keep the first one
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto result = Files.insert(std::make_pair(key, file));
+    Size -= reserved;
+    if (result.second) {
+        Size += file->Buffer->getBufferSize();
+    }
+    return result.first->second;
+}
+
+void CachingFileSystem::prefetch(const std::string &path, unsigned depth) {
+    std::string key = getKey(path);
+    if (lookup(key)) {
+        return;
+    }
+    std::shared_ptr<CachedFile> file = load(key);
+    if (!file || depth == 0) {
+        return;
+    }
+
+    // Quoted includes are looked up next to the including file first
+    StringRef directory = sys::path::parent_path(key);
+    StringRef content = file->Buffer->getBuffer();
+    while (!content.empty()) {
+        std::pair<StringRef, StringRef> lines = content.split('\n');
+        StringRef line = lines.first.ltrim();
+        content = lines.second;
+
+        if (!line.startswith("#")) {
+            continue;
+        }
+        line = line.drop_front().ltrim();
+        if (line.startswith("import")) {
+            line = line.drop_front(6).ltrim();
+        } else if (line.startswith("include")) {
+            line = line.drop_front(7).ltrim();
+        } else {
+            continue;
+        }
+        if (!line.startswith("\"")) {
+            continue;
+        }
+
+        StringRef header = line.drop_front().split('"').first;
+        SmallString<256> headerPath(directory);
+        sys::path::append(headerPath, header);
+        prefetch(headerPath.str().str(), depth - 1);
+    }
+}
+
+void CachingFileSystem::readahead(const std::vector<std::string> &files, unsigned jobs) {
+    if (!Readahead) {
+        Readahead.reset(new ThreadPool(jobs));
+    }
+    for (const std::string &file : files) {
+        Readahead->async([this, file] { prefetch(file, ReadaheadDepth); });
+    }
+}
+
+void CachingFileSystem::printStatistics(raw_ostream &os) const {
+    std::lock_guard<std::mutex> lock(Mutex);
+    os << "File cache: " << Hits.load() << " hits, " << Misses.load() << " misses, " << Files.size() << " files, "
+       << format("%.1f", Size / (1024.0 * 1024.0)) << " MB\n";
+}
@@ -0,0 +1,81 @@
+#ifndef LIBTOOLING_FILECACHE_H
+#define LIBTOOLING_FILECACHE_H
+
+#include "clang/Basic/VirtualFileSystem.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace clang {
+    /// \brief A file system keeping the content of the files it reads in memory.
+    ///
+    /// ClangTool parses every file with a fresh SourceManager, so the project
+    /// headers are read again for every translation unit. Used as the base file
+    /// system of the tool, this serves them from memory after the first read,
+    /// and readahead() loads the sources and the headers they include on a
+    /// thread pool while the parser is busy with earlier files.
+    class CachingFileSystem : public vfs::FileSystem {
+    public:
+        /// \param capacity bytes of file content to keep, files that don't fit
+        /// are read from `base` every time
+        CachingFileSystem(IntrusiveRefCntPtr<vfs::FileSystem> base, uint64_t capacity);
+        ~CachingFileSystem() override;
+
+        llvm::ErrorOr<vfs::Status> status(const Twine &Path) override;
+        llvm::ErrorOr<std::unique_ptr<vfs::File>> openFileForRead(const Twine &Path) override;
+        vfs::directory_iterator dir_begin(const Twine &Dir, std::error_code &EC) override;
+        llvm::ErrorOr<std::string> getCurrentWorkingDirectory() const override;
+        std::error_code setCurrentWorkingDirectory(const Twine &Path) override;
+
+        /// \brief Start loading `files` and the headers they include with
+        /// `#import "..."` or `#include "..."` on `jobs` threads, in order.
+        /// Returns immediately.
+        void readahead(const std::vector<std::string> &files, unsigned jobs);
+
+        uint64_t hits() const { return Hits; }
+        uint64_t misses() const { return Misses; }
+
+        void printStatistics(llvm::raw_ostream &os) const;
+
+    private:
+        class CachedFileHandle;
+
+        struct CachedFile {
+            vfs::Status Status;
+            std::unique_ptr<llvm::MemoryBuffer> Buffer;
+        };
+
+        /// The absolute path without `.` and `..` the file is cached under
+        std::string getKey(llvm::StringRef path) const;
+
+        /// Return the cached file of a key, null if it isn't cached
+        std::shared_ptr<CachedFile> lookup(llvm::StringRef key) const;
+
+        /// Read a file from the base file system into the cache under its
+        /// key. Return null if the file can't be read or doesn't fit.
+        std::shared_ptr<CachedFile> load(llvm::StringRef key);
+
+        /// Load a file and, recursively, the quoted includes it mentions
+        void prefetch(const std::string &path, unsigned depth);
+
+        IntrusiveRefCntPtr<vfs::FileSystem> Base;
+        uint64_t Capacity;
+
+        mutable std::mutex Mutex;
+        llvm::StringMap<std::shared_ptr<CachedFile>> Files;
+        uint64_t Size;
+
+        std::atomic<uint64_t> Hits;
+        std::atomic<uint64_t> Misses;
+
+        std::unique_ptr<llvm::ThreadPool> Readahead;
+    };
+}
+
+#endif //LIBTOOLING_FILECACHE_H
@@ -0,0 +1,220 @@
+#include "FilterRules.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace clang;
+using namespace llvm;
+
+FilterRules::PrefixTrie::PrefixTrie() {
+    Nodes.push_back({{}, NoRule});
+}
+
+void FilterRules::PrefixTrie::insert(StringRef prefix, unsigned rule) {
+    unsigned current = 0;
+    for (char c : prefix) {
+        unsigned next = 0;
+        for (const std::pair<char, unsigned> &child : Nodes[current].Children) {
+            if (child.first == c) {
+                next = child.second;
+                break;
+            }
+        }
+        if (!next) {
+            next = Nodes.size();
+            Nodes[current].Children.push_back(std::make_pair(c, next));
+            Nodes.push_back({{}, NoRule});
+        }
+        current = next;
+    }
+    Nodes[current].Rule = std::min(Nodes[current].Rule, rule);
+}
+
+unsigned FilterRules::PrefixTrie::match(StringRef str) const {
+    unsigned rule = NoRule;
+    unsigned current = 0;
+    for (char c : str) {
+        unsigned next = 0;
+        for (const std::pair<char, unsigned> &child : Nodes[current].Children) {
+            if (child.first == c) {
+                next = child.second;
+                break;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        current = next;
+        rule = std::min(rule, Nodes[current].Rule);
+    }
+    return rule;
+}
+
+const unsigned FilterRules::NoRule;
+
+FilterRules::FilterRules() {}
+
+FilterRules::~FilterRules() {}
+
+bool FilterRules::load(const std::string &path, const std::string &basePath) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+    if (!buffer) {
+        llvm::errs() << "Error: " << path << ": " << buffer.getError().message() << "\n";
+        return false;
+    }
+
+    StringRef content = (*buffer)->getBuffer();
+    for (unsigned lineNumber = 1; !content.empty(); ++lineNumber) {
+        std::pair<StringRef, StringRef> lines = content.split('\n');
+        content = lines.second;
+
+        StringRef line = lines.first.split('#').first.trim();
+        if (line.empty()) {
+            continue;
+        }
+
+        std::string error;
+        if (!addRule(line, basePath, error)) {
+            llvm::errs() << "Error: " << path << ":" << lineNumber << ": " << error << "\n";
+            return false;
+        }
+    }
+
+    compileRegexes();
+    return true;
+}
+
+bool FilterRules::addRule(StringRef line, const std::string &basePath, std::string &error) {
+    std::pair<StringRef, StringRef> action = line.split(' ');
+    std::pair<StringRef, StringRef> kind = action.second.ltrim().split(' ');
+    StringRef pattern = kind.second.trim();
+
+    Rule rule;
+    if (action.first == "drop") {
+        rule.Act = Drop;
+    } else if (action.first == "collapse") {
+        rule.Act = Collapse;
+    } else {
+        error = "unknown action '" + action.first.str() + "', expected drop or collapse";
+        return false;
+    }
+    if (pattern.empty()) {
+        error = "missing pattern";
+        return false;
+    }
+
+    unsigned index = Rules.size();
+    if (kind.first == "name") {
+        Names.insert(std::make_pair(pattern, index));
+        rule.Group = pattern.str();
+    } else if (kind.first == "prefix") {
+        Prefixes.insert(pattern, index);
+        rule.Group = pattern.str() + "*";
+    } else if (kind.first == "class") {
+        Classes.insert(std::make_pair(pattern, index));
+        rule.Group = pattern.str();
+    } else if (kind.first == "dir") {
+        SmallString<256> dir;
+        if (!sys::path::is_absolute(pattern)) {
+            dir = basePath;
+        }
+        sys::path::append(dir, pattern);
+        sys::path::remove_dots(dir, true);
+        dir.push_back('/');
+        Dirs.insert(dir, index);
+        rule.Group = pattern.rtrim('/').str();
+    } else if (kind.first == "regex") {
+        std::unique_ptr<Regex> regex(new Regex(pattern));
+        std::string regexError;
+        if (!regex->isValid(regexError)) {
+            error = "bad regex '" + pattern.str() + "': " + regexError;
+            return false;
+        }
+        Patterns.push_back(pattern.str());
+        Regexes.push_back(std::move(regex));
+        RegexRules.push_back(index);
+        rule.Group = pattern.str();
+    } else {
+        error = "unknown kind '" + kind.first.str() + "', expected name, prefix, regex, class or dir";
+        return false;
+    }
+
+    Rules.push_back(rule);
+    return true;
+}
+
+void FilterRules::compileRegexes() {
+    if (Patterns.empty()) {
+        return;
+    }
+
+    // Every alternative is wrapped in a group, which comes after the groups
+    // of the regexes before it
+    std::string alternation;
+    unsigned group = 1;
+    RegexGroups.clear();
+    for (size_t i = 0; i < Patterns.size(); ++i) {
+        if (i) {
+            alternation += "|";
+        }
+        alternation += "(" + Patterns[i] + ")";
+        RegexGroups.push_back(group);
+        group += 1 + Regexes[i]->getNumMatches();
+    }
+    Combined.reset(new Regex(alternation));
+}
+
+unsigned FilterRules::matchRegexes(StringRef symbol, unsigned best) const {
+    if (!Combined || RegexRules.front() >= best) {
+        return NoRule;
+    }
+
+    SmallVector<StringRef, 8> groups;
+    if (!Combined->match(symbol, &groups)) {
+        return NoRule;
+    }
+
+    // The alternation reports the leftmost match, which isn't necessarily
+    // the first rule, so the regexes before it are tried on their own
+    size_t matched = 0;
+    while (matched + 1 < RegexGroups.size() &&
+           (RegexGroups[matched] >= groups.size() || !groups[RegexGroups[matched]].data())) {
+        ++matched;
+    }
+    for (size_t i = 0; i < matched && RegexRules[i] < best; ++i) {
+        if (Regexes[i]->match(symbol)) {
+            return RegexRules[i];
+        }
+    }
+    return RegexRules[matched] < best ? RegexRules[matched] : NoRule;
+}
+
+FilterRules::Match FilterRules::match(StringRef symbol, StringRef className, StringRef file) const {
+    unsigned best = NoRule;
+
+    if (!symbol.empty()) {
+        auto name = Names.find(symbol);
+        if (name != Names.end()) {
+            best = name->second;
+        }
+        best = std::min(best, Prefixes.match(symbol));
+        best = std::min(best, matchRegexes(symbol, best));
+    }
+    if (!className.empty()) {
+        auto cls = Classes.find(className);
+        if (cls != Classes.end()) {
+            best = std::min(best, cls->second);
+        }
+    }
+    if (!file.empty()) {
+        best = std::min(best, Dirs.match(file));
+    }
+
+    if (best == NoRule) {
+        return {Keep, StringRef()};
+    }
+    return {Rules[best].Act, Rules[best].Group};
+}
@@ -0,0 +1,109 @@
+#ifndef LIBTOOLING_FILTERRULES_H
+#define LIBTOOLING_FILTERRULES_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Regex.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+    /// \brief Rules dropping or collapsing symbols before they enter the graph.
+    ///
+    /// A rules file has one `<action> <kind> <pattern>` rule per line, `#`
+    /// starts a comment:
+    ///
+    ///   drop name NSLog               the symbol with exactly this name
+    ///   drop prefix __                symbols starting with the pattern
+    ///   drop regex ^DDLog             symbols matching the extended regex
+    ///   collapse class AFHTTPManager  all methods of the class become one node
+    ///   collapse dir Pods             everything declared under the folder
+    ///
+    /// Symbols are matched by their qualified name, `-[Class selector]` for
+    /// Objective-C methods. Relative folders are relative to the scanned
+    /// folder. When several rules match a symbol the first one in the file wins.
+    ///
+    /// The rules are compiled once: names and classes into hash tables,
+    /// prefixes and folders into tries, and all regexes into one alternation,
+    /// so most symbols are decided without trying the rules one by one.
+    class FilterRules {
+    public:
+        enum Action {
+            Keep,
+            Drop,
+            Collapse
+        };
+
+        struct Match {
+            Action Act;
+
+            /// Label of the node replacing the collapsed symbols
+            llvm::StringRef Group;
+        };
+
+        FilterRules();
+        ~FilterRules();
+
+        /// \brief Load and compile a rules file, reporting the first bad line.
+        bool load(const std::string &path, const std::string &basePath);
+
+        bool empty() const { return Rules.empty(); }
+
+        /// \param symbol qualified name of the declaration, may be empty
+        /// \param className class of a method, empty for other declarations
+        /// \param file file the declaration is in
+        Match match(llvm::StringRef symbol, llvm::StringRef className, llvm::StringRef file) const;
+
+    private:
+        /// Maps every string to the smallest rule of the patterns it starts with
+        class PrefixTrie {
+        public:
+            PrefixTrie();
+
+            void insert(llvm::StringRef prefix, unsigned rule);
+
+            /// Smallest rule of the inserted prefixes of `str`, NoRule if none
+            unsigned match(llvm::StringRef str) const;
+
+        private:
+            struct Node {
+                llvm::SmallVector<std::pair<char, unsigned>, 4> Children;
+                unsigned Rule;
+            };
+            std::vector<Node> Nodes;
+        };
+
+        struct Rule {
+            Action Act;
+            std::string Group;
+        };
+
+        static const unsigned NoRule = ~0u;
+
+        bool addRule(llvm::StringRef line, const std::string &basePath, std::string &error);
+
+        /// Build the alternation of all regexes
+        void compileRegexes();
+
+        /// Smallest regex rule matching `symbol`, NoRule if none is smaller than `best`
+        unsigned matchRegexes(llvm::StringRef symbol, unsigned best) const;
+
+        std::vector<Rule> Rules;
+
+        llvm::StringMap<unsigned> Names;
+        llvm::StringMap<unsigned> Classes;
+        PrefixTrie Prefixes;
+        PrefixTrie Dirs;
+
+        /// The regexes in rule order, with the group of every alternative of Combined
+        std::vector<std::string> Patterns;
+        std::vector<std::unique_ptr<llvm::Regex>> Regexes;
+        std::vector<unsigned> RegexRules;
+        std::vector<unsigned> RegexGroups;
+        std::unique_ptr<llvm::Regex> Combined;
+    };
+}
+
+#endif //LIBTOOLING_FILTERRULES_H
@@ -0,0 +1,345 @@
+#include "GraphAnalysis.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/ThreadPool.h"
+#include <algorithm>
+#include <thread>
+
+using namespace clang;
+using namespace llvm;
+
+/// Entry points that are always used, `-entry` adds more
+static const char *const DefaultEntries[] = {
+        "main",
+        "application:didFinishLaunchingWithOptions:",
+        "application:willFinishLaunchingWithOptions:",
+        "applicationDidBecomeActive:",
+        "applicationWillEnterForeground:",
+        "applicationDidEnterBackground:",
+        "applicationWillTerminate:",
+        "load",
+        "initialize",
+};
+
+/// The selector of a `-[Class selector]` name, empty for other names
+static StringRef getSelector(StringRef name) {
+    if ((name.startswith("-[") || name.startswith("+[")) && name.endswith("]")) {
+        return name.drop_front(2).drop_back().split(' ').second;
+    }
+    return StringRef();
+}
+
+/// The function declaring a block named `function::blockN`, empty for other names
+static StringRef getEnclosingName(StringRef name) {
+    size_t pos = name.rfind("::block");
+    if (pos == StringRef::npos || pos + 7 == name.size() ||
+        name.substr(pos + 7).find_first_not_of("0123456789") != StringRef::npos) {
+        return StringRef();
+    }
+    return name.substr(0, pos);
+}
+
+std::vector<std::vector<GraphAnalysis::SymbolID>> GraphAnalysis::findRecursionCycles() const {
+    // Iterative Tarjan, the recursive version overflows on long call chains
+    const unsigned unvisited = ~0u;
+    std::vector<unsigned> index(G.size(), unvisited);
+    std::vector<unsigned> lowLink(G.size(), 0);
+    std::vector<bool> onStack(G.size(), false);
+    std::vector<SymbolID> stack;
+    std::vector<std::pair<SymbolID, unsigned>> frames; // (node, next callee)
+    std::vector<std::vector<SymbolID>> cycles;
+    unsigned nextIndex = 0;
+
+    for (SymbolID root = 0; root < G.size(); ++root) {
+        if (index[root] != unvisited) {
+            continue;
+        }
+
+        index[root] = lowLink[root] = nextIndex++;
+        stack.push_back(root);
+        onStack[root] = true;
+        frames.push_back(std::make_pair(root, 0u));
+
+        while (!frames.empty()) {
+            SymbolID node = frames.back().first;
+            ArrayRef<SymbolID> callees = G.callees(node);
+
+            if (frames.back().second < callees.size()) {
+                SymbolID callee = callees[frames.back().second++];
+                if (index[callee] == unvisited) {
+                    index[callee] = lowLink[callee] = nextIndex++;
+                    stack.push_back(callee);
+                    onStack[callee] = true;
+                    frames.push_back(std::make_pair(callee, 0u));
+                } else if (onStack[callee]) {
+                    lowLink[node] = std::min(lowLink[node], index[callee]);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (!frames.empty()) {
+                SymbolID parent = frames.back().first;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[node]);
+            }
+            if (lowLink[node] != index[node]) {
+                continue;
+            }
+
+            // `node` is the root of a component
+            std::vector<SymbolID> component;
+            SymbolID member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = false;
+                component.push_back(member);
+            } while (member != node);
+
+            bool isCycle = component.size() > 1 ||
+                           std::binary_search(callees.begin(), callees.end(), node);
+            if (isCycle) {
+                std::sort(component.begin(), component.end());
+                cycles.push_back(std::move(component));
+            }
+        }
+    }
+
+    std::sort(cycles.begin(), cycles.end(),
+              [](const std::vector<SymbolID> &lhs, const std::vector<SymbolID> &rhs) {
+                  if (lhs.size() != rhs.size()) {
+                      return lhs.size() > rhs.size();
+                  }
+                  return lhs.front() < rhs.front();
+              });
+    return cycles;
+}
+
+std::vector<GraphAnalysis::SymbolID>
+GraphAnalysis::findUnreachable(const std::vector<std::string> &entries) const {
+    std::vector<bool> reached(G.size(), false);
+    std::vector<SymbolID> worklist;
+
+    // Entries are matched against the qualified name and, for Objective-C
+    // methods, the selector alone, so `load` is every `+[Class load]`
+    StringSet<> names;
+    std::vector<StringRef> prefixes;
+    for (const std::string &entry : entries) {
+        StringRef pattern(entry);
+        if (pattern.endswith("*")) {
+            prefixes.push_back(pattern.drop_back());
+        } else {
+            names.insert(pattern);
+        }
+    }
+
+    for (SymbolID ID = 0; ID < G.size(); ++ID) {
+        StringRef name = G.getName(ID);
+        StringRef selector = getSelector(name);
+        bool isEntry = names.count(name) || (!selector.empty() && names.count(selector));
+        for (size_t i = 0; i < prefixes.size() && !isEntry; ++i) {
+            isEntry = name.startswith(prefixes[i]) || (!selector.empty() && selector.startswith(prefixes[i]));
+        }
+        if (isEntry) {
+            reached[ID] = true;
+            worklist.push_back(ID);
+        }
+    }
+
+    // A block passed as an argument has no caller in the graph, it's used
+    // when the function declaring it is
+    std::vector<std::pair<SymbolID, SymbolID>> blocks; // (enclosing, block)
+    for (SymbolID ID = 0; ID < G.size(); ++ID) {
+        SymbolID enclosing;
+        if (G.lookup(getEnclosingName(G.getName(ID)), enclosing)) {
+            blocks.push_back(std::make_pair(enclosing, ID));
+        }
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    while (!worklist.empty()) {
+        SymbolID node = worklist.back();
+        worklist.pop_back();
+        for (SymbolID callee : G.callees(node)) {
+            if (!reached[callee]) {
+                reached[callee] = true;
+                worklist.push_back(callee);
+            }
+        }
+        auto range = std::equal_range(blocks.begin(), blocks.end(), std::make_pair(node, SymbolID(0)),
+                                      [](const std::pair<SymbolID, SymbolID> &lhs,
+                                         const std::pair<SymbolID, SymbolID> &rhs) {
+                                          return lhs.first < rhs.first;
+                                      });
+        for (auto it = range.first; it != range.second; ++it) {
+            if (!reached[it->second]) {
+                reached[it->second] = true;
+                worklist.push_back(it->second);
+            }
+        }
+    }
+
+    std::vector<SymbolID> unreachable;
+    for (SymbolID ID = 0; ID < G.size(); ++ID) {
+        if (!reached[ID]) {
+            unreachable.push_back(ID);
+        }
+    }
+    return unreachable;
+}
+
+std::vector<unsigned> GraphAnalysis::computeFanIn(unsigned jobs) const {
+    const std::vector<SymbolGraph::Edge> &edges = G.edges();
+    std::vector<unsigned> fanIn(G.size(), 0);
+    if (jobs <= 1 || edges.size() < 65536) {
+        for (const SymbolGraph::Edge &edge : edges) {
+            ++fanIn[edge.second];
+        }
+        return fanIn;
+    }
+
+    // Count each slice of the edge list into its own array, then sum the
+    // arrays slice by slice over the nodes, so no counter is shared.
+    std::vector<std::vector<unsigned>> partial(jobs);
+    ThreadPool pool(jobs);
+    for (unsigned t = 0; t < jobs; ++t) {
+        pool.async([&, t] {
+            std::vector<unsigned> &counts = partial[t];
+            counts.assign(G.size(), 0);
+            size_t begin = edges.size() * t / jobs;
+            size_t end = edges.size() * (t + 1) / jobs;
+            for (size_t i = begin; i < end; ++i) {
+                ++counts[edges[i].second];
+            }
+        });
+    }
+    pool.wait();
+
+    for (unsigned t = 0; t < jobs; ++t) {
+        pool.async([&, t] {
+            size_t begin = G.size() * t / jobs;
+            size_t end = G.size() * (t + 1) / jobs;
+            for (const std::vector<unsigned> &counts : partial) {
+                for (size_t i = begin; i < end; ++i) {
+                    fanIn[i] += counts[i];
+                }
+            }
+        });
+    }
+    pool.wait();
+    return fanIn;
+}
+
+std::vector<unsigned> GraphAnalysis::computeFanOut() const {
+    std::vector<unsigned> fanOut(G.size());
+    for (SymbolID ID = 0; ID < G.size(); ++ID) {
+        fanOut[ID] = G.callees(ID).size();
+    }
+    return fanOut;
+}
+
+std::vector<GraphAnalysis::SymbolID>
+GraphAnalysis::topN(const std::vector<unsigned> &values, unsigned count) {
+    std::vector<SymbolID> IDs(values.size());
+    for (SymbolID ID = 0; ID < IDs.size(); ++ID) {
+        IDs[ID] = ID;
+    }
+    count = std::min<size_t>(count, IDs.size());
+    std::partial_sort(IDs.begin(), IDs.begin() + count, IDs.end(),
+                      [&values](SymbolID lhs, SymbolID rhs) {
+                          if (values[lhs] != values[rhs]) {
+                              return values[lhs] > values[rhs];
+                          }
+                          return lhs < rhs;
+                      });
+    IDs.resize(count);
+    return IDs;
+}
+
+int clang::runAnalyzeCommand(int argc, const char **argv) {
+    std::vector<std::string> entries(std::begin(DefaultEntries), std::end(DefaultEntries));
+    unsigned top = 20;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> inputs;
+    for (int i = 0; i < argc; ++i) {
+        StringRef arg(argv[i]);
+        if (arg.startswith("-entry=")) {
+            SmallVector<StringRef, 8> names;
+            arg.substr(7).split(names, ',', -1, false);
+            for (StringRef name : names) {
+                entries.push_back(name.str());
+            }
+        } else if (arg.startswith("-top=")) {
+            if (arg.substr(5).getAsInteger(10, top)) {
+                llvm::errs() << "Error: invalid value " << arg << "\n";
+                return 1;
+            }
+        } else if (arg.startswith("-j=")) {
+            if (arg.substr(3).getAsInteger(10, jobs) || jobs == 0) {
+                llvm::errs() << "Error: invalid value " << arg << "\n";
+                return 1;
+            }
+        } else {
+            inputs.push_back(arg.str());
+        }
+    }
+
+    if (inputs.empty()) {
+        llvm::errs() << "Usage: clang-mapper analyze [-entry=a,b] [-top=N] [-j=N] <path>...\n"
+                     << "  <path> is a .dot file, an output folder or an archive of clang-mapper\n";
+        return 1;
+    }
+
+    SymbolGraph graph;
+    for (const std::string &input : inputs) {
+        if (!graph.loadPath(input, jobs)) {
+            return 1;
+        }
+    }
+    graph.finalize();
+
+    // The passes are independent, run them side by side
+    GraphAnalysis analysis(graph);
+    std::vector<std::vector<GraphAnalysis::SymbolID>> cycles;
+    std::vector<GraphAnalysis::SymbolID> unreachable;
+    std::vector<unsigned> fanOut;
+    {
+        ThreadPool pool(std::min(jobs, 3u));
+        pool.async([&] { cycles = analysis.findRecursionCycles(); });
+        pool.async([&] { unreachable = analysis.findUnreachable(entries); });
+        pool.async([&] { fanOut = analysis.computeFanOut(); });
+        pool.wait();
+    }
+    std::vector<unsigned> fanIn = analysis.computeFanIn(jobs);
+
+    raw_ostream &OS = llvm::outs();
+    OS << "Nodes: " << graph.size() << ", Edges: " << graph.edges().size() << "\n";
+
+    OS << "\nRecursion cycles: " << cycles.size() << "\n";
+    for (const std::vector<SymbolGraph::SymbolID> &cycle : cycles) {
+        OS << "  [" << cycle.size() << "]";
+        for (SymbolGraph::SymbolID ID : cycle) {
+            OS << " " << graph.getName(ID);
+        }
+        OS << "\n";
+    }
+
+    OS << "\nUnreachable from entry points: " << unreachable.size() << "\n";
+    for (SymbolGraph::SymbolID ID : unreachable) {
+        OS << "  " << graph.getName(ID) << "\n";
+    }
+
+    OS << "\nTop " << top << " fan-in:\n";
+    for (SymbolGraph::SymbolID ID : GraphAnalysis::topN(fanIn, top)) {
+        OS << "  " << fanIn[ID] << "\t" << graph.getName(ID) << "\n";
+    }
+
+    OS << "\nTop " << top << " fan-out:\n";
+    for (SymbolGraph::SymbolID ID : GraphAnalysis::topN(fanOut, top)) {
+        OS << "  " << fanOut[ID] << "\t" << graph.getName(ID) << "\n";
+    }
+    OS.flush();
+    return 0;
+}
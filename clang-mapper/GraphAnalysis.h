@@ -0,0 +1,45 @@
+#ifndef LIBTOOLING_GRAPHANALYSIS_H
+#define LIBTOOLING_GRAPHANALYSIS_H
+
+#include "SymbolGraph.h"
+#include <string>
+#include <vector>
+
+namespace clang {
+    /// \brief Whole program analyses over a finalized SymbolGraph.
+    ///
+    /// All passes work on the adjacency arrays of the graph and don't recurse,
+    /// so they are linear in the size of the graph and safe on deep call chains.
+    class GraphAnalysis {
+    public:
+        typedef SymbolGraph::SymbolID SymbolID;
+
+        explicit GraphAnalysis(const SymbolGraph &graph) : G(graph) {}
+
+        /// \brief Find the strongly connected components which form a recursion,
+        /// i.e. contain more than one node or a node calling itself.
+        std::vector<std::vector<SymbolID>> findRecursionCycles() const;
+
+        /// \brief Find the nodes that can't be reached from any of the entries.
+        /// An entry is a qualified name or the selector of a method, one
+        /// ending with '*' matches every symbol with that prefix.
+        std::vector<SymbolID> findUnreachable(const std::vector<std::string> &entries) const;
+
+        /// \brief Count the distinct callers of every node, using `jobs` threads.
+        std::vector<unsigned> computeFanIn(unsigned jobs) const;
+
+        /// \brief Count the distinct callees of every node.
+        std::vector<unsigned> computeFanOut() const;
+
+        /// \brief Return the `count` nodes with the largest value, ties broken by name.
+        static std::vector<SymbolID> topN(const std::vector<unsigned> &values, unsigned count);
+
+    private:
+        const SymbolGraph &G;
+    };
+
+    /// \brief Entry of `clang-mapper analyze [-entry=a,b] [-top=N] [-j=N] <path>...`
+    int runAnalyzeCommand(int argc, const char **argv);
+}
+
+#endif //LIBTOOLING_GRAPHANALYSIS_H
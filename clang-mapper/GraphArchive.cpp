@@ -0,0 +1,317 @@
+#include "GraphArchive.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Process.h"
+#include <algorithm>
+
+using namespace clang;
+using namespace llvm;
+
+static const char ArchiveMagic[] = "CMGA";
+static const char IndexMagic[] = "CMGI";
+static const uint32_t ArchiveVersion = 1;
+static const size_t HeaderSize = 8;
+static const size_t FooterSize = 16;
+
+static void writeLE(raw_ostream &OS, uint64_t value, unsigned bytes) {
+    for (unsigned i = 0; i < bytes; ++i) {
+        OS << (char)((value >> (i * 8)) & 0xff);
+    }
+}
+
+static uint64_t readLE(const char *data, unsigned bytes) {
+    uint64_t value = 0;
+    for (unsigned i = 0; i < bytes; ++i) {
+        value |= (uint64_t)(unsigned char)data[i] << (i * 8);
+    }
+    return value;
+}
+
+bool GraphArchiveReader::isArchive(const std::string &path) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFileSlice(path, HeaderSize, 0);
+    return buffer && (*buffer)->getBuffer().startswith(ArchiveMagic);
+}
+
+bool GraphArchiveReader::open(const std::string &path) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+    if (!buffer) {
+        llvm::errs() << "Error: " << path << ": " << buffer.getError().message() << "\n";
+        return false;
+    }
+    Buffer = std::move(*buffer);
+    Entries.clear();
+
+    StringRef data = Buffer->getBuffer();
+    if (data.size() < HeaderSize || !data.startswith(ArchiveMagic)) {
+        llvm::errs() << "Error: " << path << " is not a graph archive\n";
+        return false;
+    }
+
+    // A run that was killed before close() leaves entries without an index
+    // after the last complete footer, so look for the last one that is valid
+    ValidSize = HeaderSize;
+    StringRef searched = data;
+    while (searched.size() >= HeaderSize + FooterSize) {
+        size_t magic = searched.rfind(IndexMagic);
+        if (magic == StringRef::npos || magic + 4 < HeaderSize + FooterSize) {
+            break;
+        }
+        if (readIndex(magic + 4)) {
+            ValidSize = magic + 4;
+            break;
+        }
+        searched = searched.substr(0, magic + 3);
+    }
+
+    if (ValidSize != data.size()) {
+        llvm::errs() << path << ": ignoring " << data.size() - ValidSize
+                     << " bytes after the last complete index\n";
+    }
+    return true;
+}
+
+bool GraphArchiveReader::readIndex(size_t footerEnd) {
+    StringRef data = Buffer->getBuffer();
+    const char *footer = data.begin() + footerEnd - FooterSize;
+    uint64_t indexOffset = readLE(footer, 8);
+    uint32_t count = readLE(footer + 8, 4);
+    if (indexOffset < HeaderSize || indexOffset > footerEnd - FooterSize) {
+        return false;
+    }
+
+    std::vector<GraphArchiveEntry> entries;
+    const char *pos = data.begin() + indexOffset;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (footer - pos < 4) {
+            return false;
+        }
+        uint32_t nameLength = readLE(pos, 4);
+        pos += 4;
+        if ((uint64_t)(footer - pos) < nameLength + 25) {
+            return false;
+        }
+
+        GraphArchiveEntry entry;
+        entry.Name.assign(pos, nameLength);
+        pos += nameLength;
+        entry.Offset = readLE(pos, 8);
+        entry.StoredSize = readLE(pos + 8, 8);
+        entry.RawSize = readLE(pos + 16, 8);
+        entry.Compressed = pos[24] != 0;
+        pos += 25;
+
+        if (entry.Offset < HeaderSize || entry.Offset + entry.StoredSize > indexOffset) {
+            return false;
+        }
+        entries.push_back(entry);
+    }
+
+    // The index fills the space up to the footer exactly
+    if (pos != footer) {
+        return false;
+    }
+    Entries.swap(entries);
+    return true;
+}
+
+const GraphArchiveEntry *GraphArchiveReader::find(StringRef name) const {
+    for (const GraphArchiveEntry &entry : Entries) {
+        if (entry.Name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+StringRef GraphArchiveReader::getStoredData(const GraphArchiveEntry &entry) const {
+    return Buffer->getBuffer().substr(entry.Offset, entry.StoredSize);
+}
+
+bool GraphArchiveReader::extract(const GraphArchiveEntry &entry, std::string &content) const {
+    StringRef stored = getStoredData(entry);
+    if (!entry.Compressed) {
+        content = stored.str();
+        return true;
+    }
+
+    SmallString<0> uncompressed;
+    if (Error E = zlib::uncompress(stored, uncompressed, entry.RawSize)) {
+        llvm::errs() << "Error: " << entry.Name << ": " << toString(std::move(E)) << "\n";
+        return false;
+    }
+    content = uncompressed.str().str();
+    return true;
+}
+
+bool GraphArchiveWriter::open(const std::string &path) {
+    close();
+    Entries.clear();
+    Positions.clear();
+
+    uint64_t size = 0;
+    if (sys::fs::exists(path) && !sys::fs::file_size(path, size) && size > 0) {
+        GraphArchiveReader existing;
+        if (!existing.open(path)) {
+            return false;
+        }
+        Entries = existing.entries();
+        for (size_t i = 0; i < Entries.size(); ++i) {
+            Positions[Entries[i].Name] = i;
+        }
+        size = existing.getValidSize();
+    }
+
+    // Drop what an unfinished run left after the last index before appending
+    int FD = -1;
+    std::error_code EC = sys::fs::openFileForWrite(path, FD, sys::fs::F_Append);
+    if (!EC && size > 0) {
+        EC = sys::fs::resize_file(FD, size);
+    }
+    if (EC) {
+        llvm::errs() << "Error: " << EC.message() << "\n";
+        if (FD >= 0) {
+            sys::Process::SafelyCloseFileDescriptor(FD);
+        }
+        return false;
+    }
+    Out.reset(new raw_fd_ostream(FD, true));
+
+    Offset = size;
+    if (size == 0) {
+        *Out << ArchiveMagic;
+        writeLE(*Out, ArchiveVersion, 4);
+        Offset = HeaderSize;
+    }
+    return true;
+}
+
+void GraphArchiveWriter::writeEntry(StringRef name, StringRef stored, uint64_t rawSize, bool compressed) {
+    GraphArchiveEntry entry = {name.str(), Offset, stored.size(), rawSize, compressed};
+    *Out << stored;
+    Offset += stored.size();
+
+    auto position = Positions.find(name);
+    if (position != Positions.end()) {
+        Entries[position->second] = entry;
+    } else {
+        Positions[name] = Entries.size();
+        Entries.push_back(entry);
+    }
+}
+
+bool GraphArchiveWriter::add(StringRef name, StringRef content) {
+    if (!Out) {
+        return false;
+    }
+
+    if (zlib::isAvailable()) {
+        SmallString<0> compressed;
+        if (Error E = zlib::compress(content, compressed)) {
+            consumeError(std::move(E));
+        } else {
+            writeEntry(name, compressed, content.size(), true);
+            return true;
+        }
+    }
+    writeEntry(name, content, content.size(), false);
+    return true;
+}
+
+bool GraphArchiveWriter::addArchive(const std::string &path) {
+    if (!Out) {
+        return false;
+    }
+
+    GraphArchiveReader other;
+    if (!other.open(path)) {
+        return false;
+    }
+    for (const GraphArchiveEntry &entry : other.entries()) {
+        writeEntry(entry.Name, other.getStoredData(entry), entry.RawSize, entry.Compressed);
+    }
+    return true;
+}
+
+bool GraphArchiveWriter::close() {
+    if (!Out) {
+        return true;
+    }
+
+    // Sorted by name, so the index doesn't depend on the order of add()
+    std::sort(Entries.begin(), Entries.end(), [](const GraphArchiveEntry &lhs, const GraphArchiveEntry &rhs) {
+        return lhs.Name < rhs.Name;
+    });
+
+    uint64_t indexOffset = Offset;
+    for (const GraphArchiveEntry &entry : Entries) {
+        writeLE(*Out, entry.Name.size(), 4);
+        *Out << entry.Name;
+        writeLE(*Out, entry.Offset, 8);
+        writeLE(*Out, entry.StoredSize, 8);
+        writeLE(*Out, entry.RawSize, 8);
+        writeLE(*Out, entry.Compressed ? 1 : 0, 1);
+    }
+    writeLE(*Out, indexOffset, 8);
+    writeLE(*Out, Entries.size(), 4);
+    *Out << IndexMagic;
+
+    Out->close();
+    bool success = !Out->has_error();
+    if (!success) {
+        llvm::errs() << "Error: failed to write graph archive\n";
+        Out->clear_error();
+    }
+    Out.reset();
+    return success;
+}
+
+int clang::runArchiveCommand(int argc, const char **argv) {
+    if (argc < 2 || (StringRef(argv[0]) != "list" && StringRef(argv[0]) != "extract")) {
+        llvm::errs() << "Usage: clang-mapper archive list <file>\n"
+                     << "       clang-mapper archive extract <file> <entry> [-o file]\n";
+        return 1;
+    }
+
+    GraphArchiveReader reader;
+    if (!reader.open(argv[1])) {
+        return 1;
+    }
+
+    if (StringRef(argv[0]) == "list") {
+        for (const GraphArchiveEntry &entry : reader.entries()) {
+            llvm::outs() << entry.RawSize << "\t" << entry.StoredSize << "\t" << entry.Name << "\n";
+        }
+        return 0;
+    }
+
+    if (argc < 3) {
+        llvm::errs() << "Error: missing entry name\n";
+        return 1;
+    }
+    const GraphArchiveEntry *entry = reader.find(argv[2]);
+    if (!entry) {
+        llvm::errs() << "Error: " << argv[2] << " not found in " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::string content;
+    if (!reader.extract(*entry, content)) {
+        return 1;
+    }
+
+    if (argc >= 5 && StringRef(argv[3]) == "-o") {
+        std::error_code EC;
+        raw_fd_ostream O(argv[4], EC, sys::fs::F_None);
+        if (EC) {
+            llvm::errs() << "Error: " << EC.message() << "\n";
+            return 1;
+        }
+        O << content;
+        errs() << "Write to " << argv[4] << "\n";
+    } else {
+        llvm::outs() << content;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+#ifndef LIBTOOLING_GRAPHARCHIVE_H
+#define LIBTOOLING_GRAPHARCHIVE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+    /// \brief Entry of a graph archive (.cmga).
+    ///
+    /// An archive holds every graph of a run in one file instead of a mirrored
+    /// folder tree:
+    ///
+    ///   "CMGA" version:u32
+    ///   entry data...                   zlib compressed when available
+    ///   index: count * (nameLen:u32 name offset:u64 storedSize:u64 rawSize:u64 compressed:u8)
+    ///   footer: indexOffset:u64 count:u32 "CMGI"
+    ///
+    /// Every write session only appends its entries and a complete index, so
+    /// the last footer describes the whole archive. A session that dies
+    /// before writing its index leaves entries after that footer, they are
+    /// ignored by the reader and overwritten by the next writer.
+    struct GraphArchiveEntry {
+        std::string Name;
+        uint64_t Offset;
+        uint64_t StoredSize;
+        uint64_t RawSize;
+        bool Compressed;
+    };
+
+    class GraphArchiveReader {
+    public:
+        /// \brief Return true if `path` starts with the archive magic.
+        static bool isArchive(const std::string &path);
+
+        bool open(const std::string &path);
+
+        const std::vector<GraphArchiveEntry> &entries() const { return Entries; }
+
+        /// \brief Size of the archive up to the end of its last complete index.
+        uint64_t getValidSize() const { return ValidSize; }
+
+        /// \brief Lookup an entry by name, return null if not found.
+        const GraphArchiveEntry *find(llvm::StringRef name) const;
+
+        /// \brief Get the uncompressed content of an entry.
+        bool extract(const GraphArchiveEntry &entry, std::string &content) const;
+
+        /// \brief Get the bytes of an entry as stored in the archive.
+        llvm::StringRef getStoredData(const GraphArchiveEntry &entry) const;
+
+    private:
+        /// \brief Read the index of the footer ending at `footerEnd`, return
+        /// false if it isn't consistent.
+        bool readIndex(size_t footerEnd);
+
+        std::unique_ptr<llvm::MemoryBuffer> Buffer;
+        std::vector<GraphArchiveEntry> Entries;
+        uint64_t ValidSize = 0;
+    };
+
+    class GraphArchiveWriter {
+    public:
+        GraphArchiveWriter() : Offset(0) {}
+        ~GraphArchiveWriter() { close(); }
+
+        /// \brief Open an archive for appending, creating it if it doesn't exist.
+        bool open(const std::string &path);
+
+        bool isOpen() const { return Out != nullptr; }
+
+        /// \brief Compress and append an entry. An entry with the same name
+        /// replaces the old one in the index.
+        bool add(llvm::StringRef name, llvm::StringRef content);
+
+        /// \brief Append all entries of another archive without recompressing.
+        bool addArchive(const std::string &path);
+
+        /// \brief Write the index and close the file.
+        bool close();
+
+    private:
+        void writeEntry(llvm::StringRef name, llvm::StringRef stored, uint64_t rawSize, bool compressed);
+
+        std::unique_ptr<llvm::raw_fd_ostream> Out;
+        uint64_t Offset;
+        std::vector<GraphArchiveEntry> Entries;
+        llvm::StringMap<size_t> Positions;
+    };
+
+    /// \brief Entry of `clang-mapper archive list <file>` and
+    /// `clang-mapper archive extract <file> <entry> [-o file]`
+    int runArchiveCommand(int argc, const char **argv);
+}
+
+#endif //LIBTOOLING_GRAPHARCHIVE_H
@@ -0,0 +1,218 @@
+#include "GraphDiff.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/GraphWriter.h"
+#include <deque>
+
+using namespace clang;
+using namespace llvm;
+
+GraphDiff::GraphDiff(const SymbolGraph &oldGraph, const SymbolGraph &newGraph) {
+    assert(oldGraph.isFinalized() && newGraph.isFinalized());
+
+    // Merge the two sorted symbol tables
+    std::vector<UnionID> oldMap(oldGraph.size());
+    std::vector<UnionID> newMap(newGraph.size());
+    SymbolGraph::SymbolID i = 0, j = 0;
+    while (i < oldGraph.size() || j < newGraph.size()) {
+        UnionID ID = Names.size();
+        int order = 0;
+        if (i == oldGraph.size()) {
+            order = 1;
+        } else if (j == newGraph.size()) {
+            order = -1;
+        } else {
+            order = oldGraph.getName(i).compare(newGraph.getName(j));
+        }
+
+        if (order < 0) {
+            Names.push_back(oldGraph.getName(i));
+            oldMap[i++] = ID;
+            RemovedNodes.push_back(ID);
+        } else if (order > 0) {
+            Names.push_back(newGraph.getName(j));
+            newMap[j++] = ID;
+            AddedNodes.push_back(ID);
+        } else {
+            Names.push_back(oldGraph.getName(i));
+            oldMap[i++] = ID;
+            newMap[j++] = ID;
+        }
+    }
+
+    // The maps are monotonic, so both edge lists stay sorted after mapping
+    const std::vector<SymbolGraph::Edge> &oldEdges = oldGraph.edges();
+    const std::vector<SymbolGraph::Edge> &newEdges = newGraph.edges();
+    size_t oi = 0, ni = 0;
+    while (oi < oldEdges.size() || ni < newEdges.size()) {
+        Edge oldEdge, newEdge;
+        if (oi < oldEdges.size()) {
+            oldEdge = Edge(oldMap[oldEdges[oi].first], oldMap[oldEdges[oi].second]);
+        }
+        if (ni < newEdges.size()) {
+            newEdge = Edge(newMap[newEdges[ni].first], newMap[newEdges[ni].second]);
+        }
+
+        if (ni == newEdges.size() || (oi < oldEdges.size() && oldEdge < newEdge)) {
+            RemovedEdges.push_back(oldEdge);
+            ++oi;
+        } else if (oi == oldEdges.size() || newEdge < oldEdge) {
+            AddedEdges.push_back(newEdge);
+            ++ni;
+        } else {
+            CommonEdges.push_back(oldEdge);
+            ++oi;
+            ++ni;
+        }
+    }
+}
+
+void GraphDiff::print(raw_ostream &os) const {
+    os << "Nodes: +" << AddedNodes.size() << " -" << RemovedNodes.size() << "\n";
+    os << "Edges: +" << AddedEdges.size() << " -" << RemovedEdges.size() << "\n";
+
+    for (UnionID ID : AddedNodes) {
+        os << "+ " << getName(ID) << "\n";
+    }
+    for (UnionID ID : RemovedNodes) {
+        os << "- " << getName(ID) << "\n";
+    }
+    for (const Edge &edge : AddedEdges) {
+        os << "+ " << getName(edge.first) << " -> " << getName(edge.second) << "\n";
+    }
+    for (const Edge &edge : RemovedEdges) {
+        os << "- " << getName(edge.first) << " -> " << getName(edge.second) << "\n";
+    }
+    os.flush();
+}
+
+void GraphDiff::writeFocusGraph(raw_ostream &os, unsigned context) const {
+    // Undirected adjacency over the union of both graphs
+    std::vector<unsigned> offsets(Names.size() + 1, 0);
+    const std::vector<Edge> *edgeLists[] = {&CommonEdges, &AddedEdges, &RemovedEdges};
+    for (const std::vector<Edge> *edges : edgeLists) {
+        for (const Edge &edge : *edges) {
+            ++offsets[edge.first + 1];
+            ++offsets[edge.second + 1];
+        }
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+    std::vector<UnionID> neighbors(offsets.back());
+    std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+    for (const std::vector<Edge> *edges : edgeLists) {
+        for (const Edge &edge : *edges) {
+            neighbors[fill[edge.first]++] = edge.second;
+            neighbors[fill[edge.second]++] = edge.first;
+        }
+    }
+
+    // Breadth first search from the changed nodes, `context` levels deep
+    const unsigned unvisited = ~0u;
+    std::vector<unsigned> depth(Names.size(), unvisited);
+    std::deque<UnionID> queue;
+    auto seed = [&](UnionID ID) {
+        if (depth[ID] == unvisited) {
+            depth[ID] = 0;
+            queue.push_back(ID);
+        }
+    };
+    for (UnionID ID : AddedNodes) seed(ID);
+    for (UnionID ID : RemovedNodes) seed(ID);
+    for (const Edge &edge : AddedEdges) { seed(edge.first); seed(edge.second); }
+    for (const Edge &edge : RemovedEdges) { seed(edge.first); seed(edge.second); }
+
+    while (!queue.empty()) {
+        UnionID ID = queue.front();
+        queue.pop_front();
+        if (depth[ID] == context) {
+            continue;
+        }
+        for (unsigned i = offsets[ID]; i < offsets[ID + 1]; ++i) {
+            if (depth[neighbors[i]] == unvisited) {
+                depth[neighbors[i]] = depth[ID] + 1;
+                queue.push_back(neighbors[i]);
+            }
+        }
+    }
+
+    std::vector<char> state(Names.size(), 0); // 1: added, 2: removed
+    for (UnionID ID : AddedNodes) state[ID] = 1;
+    for (UnionID ID : RemovedNodes) state[ID] = 2;
+
+    os << "digraph \"Call graph diff\" {\n";
+    os << "\tlabel=\"Call graph diff\";\n\n";
+    for (UnionID ID = 0; ID < Names.size(); ++ID) {
+        if (depth[ID] == unvisited) {
+            continue;
+        }
+        os << "\tNode" << ID << " [shape=record,";
+        if (state[ID] == 1) {
+            os << "style=filled,fillcolor=\"#c8f7c5\",";
+        } else if (state[ID] == 2) {
+            os << "style=filled,fillcolor=\"#f7c5c5\",";
+        }
+        os << "label=\"{" << DOT::EscapeString(getName(ID).str()) << "}\"];\n";
+    }
+
+    auto writeEdges = [&](const std::vector<Edge> &edges, const char *attrs) {
+        for (const Edge &edge : edges) {
+            if (depth[edge.first] != unvisited && depth[edge.second] != unvisited) {
+                os << "\tNode" << edge.first << " -> Node" << edge.second << attrs << ";\n";
+            }
+        }
+    };
+    writeEdges(CommonEdges, " [color=gray]");
+    writeEdges(AddedEdges, " [color=green]");
+    writeEdges(RemovedEdges, " [color=red,style=dashed]");
+    os << "}\n";
+    os.flush();
+}
+
+int clang::runDiffCommand(int argc, const char **argv) {
+    unsigned context = 1;
+    std::string outputFile;
+    std::vector<std::string> inputs;
+    for (int i = 0; i < argc; ++i) {
+        StringRef arg(argv[i]);
+        if (arg.startswith("-context=")) {
+            if (arg.substr(9).getAsInteger(10, context)) {
+                llvm::errs() << "Error: invalid context " << arg.substr(9) << "\n";
+                return 1;
+            }
+        } else if (arg == "-o" && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else {
+            inputs.push_back(arg.str());
+        }
+    }
+
+    if (inputs.size() != 2) {
+        llvm::errs() << "Usage: clang-mapper diff [-context=N] [-o file.dot] <old> <new>\n"
+                     << "  <old> and <new> are .dot files, output folders or archives of clang-mapper\n";
+        return 1;
+    }
+
+    SymbolGraph oldGraph, newGraph;
+    if (!oldGraph.loadPath(inputs[0]) || !newGraph.loadPath(inputs[1])) {
+        return 1;
+    }
+    oldGraph.finalize();
+    newGraph.finalize();
+
+    GraphDiff diff(oldGraph, newGraph);
+    diff.print(llvm::outs());
+
+    if (!outputFile.empty()) {
+        std::error_code EC;
+        raw_fd_ostream O(outputFile, EC, sys::fs::F_RW);
+        if (EC) {
+            llvm::errs() << "Error: " << EC.message() << "\n";
+            return 1;
+        }
+        diff.writeFocusGraph(O, context);
+        errs() << "Write to " << outputFile << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef LIBTOOLING_GRAPHDIFF_H
+#define LIBTOOLING_GRAPHDIFF_H
+
+#include "SymbolGraph.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+
+namespace clang {
+    /// \brief The difference between two finalized SymbolGraphs.
+    ///
+    /// Nodes are matched by their qualified name, so a method is only the same
+    /// node as the method of the same class in the other graph.
+    ///
+    /// Both graphs are mapped into the ID space of their merged, sorted symbol
+    /// table. Because that mapping preserves the name order, nodes and edges
+    /// are compared with one linear merge and no string comparison per edge.
+    class GraphDiff {
+    public:
+        typedef unsigned UnionID;
+        typedef std::pair<UnionID, UnionID> Edge;
+
+        GraphDiff(const SymbolGraph &oldGraph, const SymbolGraph &newGraph);
+
+        const std::vector<UnionID> &addedNodes() const { return AddedNodes; }
+        const std::vector<UnionID> &removedNodes() const { return RemovedNodes; }
+        const std::vector<Edge> &addedEdges() const { return AddedEdges; }
+        const std::vector<Edge> &removedEdges() const { return RemovedEdges; }
+
+        bool empty() const {
+            return AddedNodes.empty() && RemovedNodes.empty() &&
+                   AddedEdges.empty() && RemovedEdges.empty();
+        }
+
+        llvm::StringRef getName(UnionID ID) const { return Names[ID]; }
+
+        /// \brief Print the changed nodes and edges, one per line.
+        void print(llvm::raw_ostream &os) const;
+
+        /// \brief Write the changed nodes and edges, plus everything within
+        /// `context` calls of them, as a .dot graph.
+        void writeFocusGraph(llvm::raw_ostream &os, unsigned context) const;
+
+    private:
+        /// Names of the merged symbol table, owned by the two graphs
+        std::vector<llvm::StringRef> Names;
+
+        std::vector<UnionID> AddedNodes;
+        std::vector<UnionID> RemovedNodes;
+        std::vector<Edge> AddedEdges;
+        std::vector<Edge> RemovedEdges;
+
+        /// Edges present in both graphs
+        std::vector<Edge> CommonEdges;
+    };
+
+    /// \brief Entry of `clang-mapper diff [-context=N] [-o file.dot] <old> <new>`
+    int runDiffCommand(int argc, const char **argv);
+}
+
+#endif //LIBTOOLING_GRAPHDIFF_H
@@ -0,0 +1,449 @@
+#include "HtmlViewer.h"
+#include "Commons.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace clang;
+using namespace llvm;
+
+const unsigned HtmlViewer::ChunkSize;
+
+/// The viewer page. @TITLE@ is replaced by the escaped graph name and @DATA@
+/// by the data folder as a JS string.
+static const char PageTemplate[] = R"html(<!DOCTYPE html>
+<html>
+<head>
+<meta charset="utf-8">
+<title>@TITLE@</title>
+<style>
+body { font: 13px -apple-system, Helvetica, Arial, sans-serif; margin: 0; color: #222; }
+header { display: flex; align-items: center; padding: 8px 12px; background: #f3f3f3; border-bottom: 1px solid #ddd; }
+header h1 { font-size: 15px; margin: 0 16px 0 0; }
+#search { flex: 1; max-width: 480px; padding: 4px 6px; font: inherit; }
+#summary { margin-left: 16px; color: #888; }
+#results { display: none; position: absolute; top: 38px; left: 12px; width: 720px; max-width: 90%; max-height: 60vh;
+           overflow: auto; background: #fff; border: 1px solid #ccc; box-shadow: 0 2px 8px rgba(0, 0, 0, .15); }
+#results div { padding: 3px 8px; cursor: pointer; white-space: nowrap; }
+#results div.active { background: #e8f0fe; }
+main { padding: 12px; }
+main h1 { font-size: 16px; margin: 4px 0; }
+h2 { font-size: 12px; text-transform: uppercase; color: #666; }
+.symbol { font-family: Menlo, Consolas, monospace; }
+.note { color: #888; margin-left: 8px; }
+.link { cursor: pointer; color: #0645ad; }
+.link:hover { text-decoration: underline; }
+.columns { display: flex; }
+.columns section { flex: 1; min-width: 0; margin-right: 32px; }
+ul.tree { list-style: none; padding-left: 18px; margin: 2px 0; }
+main > .columns ul.tree { padding-left: 0; }
+.toggle { display: inline-block; width: 14px; cursor: pointer; color: #666; }
+</style>
+</head>
+<body>
+<header><h1>@TITLE@</h1><input id="search" placeholder="Search functions and methods" autocomplete="off"><span id="summary"></span></header>
+<div id="results"></div>
+<main id="main">Loading...</main>
+<script>
+var CallGraphViewer = (function () {
+    var dataDir = @DATA@;
+    var index = null;
+    var lowerNames = [];
+    var chunks = {};
+    var pending = {};
+
+    function element(tag, className, text) {
+        var e = document.createElement(tag);
+        if (className) {
+            e.className = className;
+        }
+        if (text !== undefined) {
+            e.textContent = text;
+        }
+        return e;
+    }
+
+    function loadScript(name) {
+        var script = document.createElement('script');
+        script.src = dataDir + '/' + name;
+        document.head.appendChild(script);
+    }
+
+    // Calls back with [callees, callers] of a node, loading its chunk first
+    function adjacency(id, callback) {
+        var chunk = Math.floor(id / index.chunkSize);
+        var done = function () {
+            callback(chunks[chunk][id - chunk * index.chunkSize]);
+        };
+        if (chunks[chunk]) {
+            done();
+            return;
+        }
+        if (!pending[chunk]) {
+            pending[chunk] = [];
+            loadScript('chunk' + chunk + '.js');
+        }
+        pending[chunk].push(done);
+    }
+
+    function nodeName(id) {
+        return index.nodes[id][0] || '< >';
+    }
+
+    function symbolLink(id) {
+        var link = element('span', 'symbol link', nodeName(id));
+        link.onclick = function () {
+            location.hash = id;
+        };
+        return link;
+    }
+
+    // An item of the callee (direction 0) or caller (direction 1) tree, its
+    // children are loaded when it's expanded the first time
+    function treeItem(id, direction, path) {
+        var item = element('li');
+        var count = index.nodes[id][4 + direction];
+        var toggle = element('span', 'toggle', '');
+        item.appendChild(toggle);
+        item.appendChild(symbolLink(id));
+
+        if (path.indexOf(id) >= 0) {
+            item.appendChild(element('span', 'note', 'recursive'));
+            return item;
+        }
+        if (!count) {
+            return item;
+        }
+        item.appendChild(element('span', 'note', count));
+        toggle.textContent = '\u25b8';
+
+        var children = null;
+        toggle.onclick = function () {
+            if (children) {
+                var hidden = children.style.display != 'none';
+                children.style.display = hidden ? 'none' : '';
+                toggle.textContent = hidden ? '\u25b8' : '\u25be';
+                return;
+            }
+            children = element('ul', 'tree');
+            item.appendChild(children);
+            toggle.textContent = '\u25be';
+            adjacency(id, function (edges) {
+                edges[direction].forEach(function (child) {
+                    children.appendChild(treeItem(child, direction, path.concat([id])));
+                });
+            });
+        };
+        return item;
+    }
+
+    function nodeLocation(id) {
+        var node = index.nodes[id];
+        return node[2] >= 0 ? index.files[node[2]] + ':' + node[3] : '';
+    }
+
+    function showNode(id) {
+        var main = document.getElementById('main');
+        main.textContent = '';
+        main.appendChild(element('h1', 'symbol', nodeName(id)));
+        main.appendChild(element('span', 'note', index.nodes[id][1] + '  ' + nodeLocation(id)));
+
+        var columns = element('div', 'columns');
+        var lists = [];
+        ['Calls', 'Called by'].forEach(function (title) {
+            var section = element('section');
+            section.appendChild(element('h2', null, title));
+            var list = element('ul', 'tree');
+            section.appendChild(list);
+            columns.appendChild(section);
+            lists.push(list);
+        });
+        main.appendChild(columns);
+
+        adjacency(id, function (edges) {
+            [0, 1].forEach(function (direction) {
+                if (!edges[direction].length) {
+                    lists[direction].appendChild(element('li', 'note', 'None'));
+                }
+                edges[direction].forEach(function (child) {
+                    lists[direction].appendChild(treeItem(child, direction, [id]));
+                });
+            });
+        });
+    }
+
+    // Functions nobody in the graph calls, the usual starting points
+    function showRoots() {
+        var roots = [];
+        index.nodes.forEach(function (node, id) {
+            if (!node[5]) {
+                roots.push(id);
+            }
+        });
+        roots.sort(function (lhs, rhs) {
+            return index.nodes[rhs][4] - index.nodes[lhs][4];
+        });
+
+        var main = document.getElementById('main');
+        main.textContent = '';
+        main.appendChild(element('h2', null, 'Not called in this graph'));
+        var list = element('ul', 'tree');
+        roots.slice(0, 500).forEach(function (id) {
+            list.appendChild(treeItem(id, 0, []));
+        });
+        main.appendChild(list);
+    }
+
+    function route() {
+        var id = parseInt(location.hash.slice(1), 10);
+        if (id >= 0 && id < index.nodes.length) {
+            showNode(id);
+        } else {
+            showRoots();
+        }
+    }
+
+    var input = document.getElementById('search');
+    var results = document.getElementById('results');
+    var matches = [];
+    var active = 0;
+
+    function choose(id) {
+        results.style.display = 'none';
+        input.value = '';
+        input.blur();
+        location.hash = id;
+    }
+
+    function highlight(position) {
+        if (!matches.length) {
+            return;
+        }
+        results.children[active].className = '';
+        active = (position + matches.length) % matches.length;
+        results.children[active].className = 'active';
+        results.children[active].scrollIntoView({block: 'nearest'});
+    }
+
+    // Names starting with the query first, then names containing it
+    function search() {
+        var query = input.value.toLowerCase();
+        results.textContent = '';
+        matches = [];
+        active = 0;
+        if (!query || !index) {
+            results.style.display = 'none';
+            return;
+        }
+        var contained = [];
+        for (var i = 0; i < lowerNames.length && matches.length < 100; ++i) {
+            var position = lowerNames[i].indexOf(query);
+            if (position == 0) {
+                matches.push(i);
+            } else if (position > 0 && contained.length < 100) {
+                contained.push(i);
+            }
+        }
+        matches = matches.concat(contained).slice(0, 100);
+        matches.forEach(function (id) {
+            var row = element('div', null);
+            row.appendChild(element('span', 'symbol', nodeName(id)));
+            row.appendChild(element('span', 'note', nodeLocation(id)));
+            row.onmousedown = function (event) {
+                event.preventDefault();
+                choose(id);
+            };
+            results.appendChild(row);
+        });
+        results.style.display = matches.length ? 'block' : 'none';
+        highlight(0);
+    }
+
+    input.oninput = search;
+    input.onfocus = search;
+    input.onblur = function () {
+        results.style.display = 'none';
+    };
+    input.onkeydown = function (event) {
+        if (event.key == 'ArrowDown' || event.key == 'ArrowUp') {
+            highlight(active + (event.key == 'ArrowDown' ? 1 : -1));
+            event.preventDefault();
+        } else if (event.key == 'Enter' && matches.length) {
+            choose(matches[active]);
+        } else if (event.key == 'Escape') {
+            input.blur();
+        }
+    };
+    window.onhashchange = route;
+
+    loadScript('index.js');
+
+    return {
+        index: function (data) {
+            index = data;
+            lowerNames = index.nodes.map(function (node) {
+                return node[0].toLowerCase();
+            });
+            var edges = index.nodes.reduce(function (sum, node) {
+                return sum + node[4];
+            }, 0);
+            document.getElementById('summary').textContent = index.nodes.length + ' nodes, ' + edges + ' calls';
+            route();
+        },
+        chunk: function (chunk, data) {
+            chunks[chunk] = data;
+            var callbacks = pending[chunk] || [];
+            delete pending[chunk];
+            callbacks.forEach(function (callback) {
+                callback();
+            });
+        }
+    };
+})();
+</script>
+</body>
+</html>
+)html";
+
+/// Escape the characters with a meaning in HTML text
+static std::string escapeHtml(StringRef str) {
+    std::string escaped;
+    for (char c : str) {
+        switch (c) {
+            case '&': escaped += "&amp;"; break;
+            case '<': escaped += "&lt;"; break;
+            case '>': escaped += "&gt;"; break;
+            case '"': escaped += "&quot;"; break;
+            default: escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static void replaceAll(std::string &str, StringRef from, StringRef to) {
+    for (size_t pos = str.find(from); pos != std::string::npos; pos = str.find(from, pos + to.size())) {
+        str.replace(pos, from.size(), to);
+    }
+}
+
+static void writeIDs(raw_ostream &O, const std::vector<unsigned> &ids) {
+    O << '[';
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i) {
+            O << ',';
+        }
+        O << ids[i];
+    }
+    O << ']';
+}
+
+unsigned HtmlViewer::addNode(StringRef name, StringRef kind, StringRef file, unsigned line) {
+    unsigned fileID = ~0u;
+    if (!file.empty()) {
+        auto result = FileIDs.insert(std::make_pair(file, Files.size()));
+        if (result.second) {
+            Files.push_back(file.str());
+        }
+        fileID = result.first->second;
+    }
+
+    Node node = {name.str(), kind.str(), fileID, line, {}, {}};
+    Nodes.push_back(node);
+    return Nodes.size() - 1;
+}
+
+void HtmlViewer::addEdge(unsigned caller, unsigned callee) {
+    Nodes[caller].Callees.push_back(callee);
+    Nodes[callee].Callers.push_back(caller);
+}
+
+bool HtmlViewer::writeIndex(const std::string &path) const {
+    std::error_code EC;
+    raw_fd_ostream O(path, EC, sys::fs::F_Text);
+    if (EC) {
+        llvm::errs() << "Error: " << EC.message() << "\n";
+        return false;
+    }
+
+    O << "CallGraphViewer.index({\"chunkSize\":" << ChunkSize << ",\"files\":[";
+    for (size_t i = 0; i < Files.size(); ++i) {
+        if (i) {
+            O << ',';
+        }
+        writeJSONString(O, Files[i]);
+    }
+
+    // [name, kind, file, line, callees, callers], file is -1 if unknown
+    O << "],\"nodes\":[";
+    for (size_t i = 0; i < Nodes.size(); ++i) {
+        const Node &node = Nodes[i];
+        O << (i ? ",\n[" : "\n[");
+        writeJSONString(O, node.Name);
+        O << ',';
+        writeJSONString(O, node.Kind);
+        O << ',' << (node.File == ~0u ? -1 : (int)node.File) << ',' << node.Line << ','
+          << node.Callees.size() << ',' << node.Callers.size() << ']';
+    }
+    O << "]});\n";
+    return true;
+}
+
+bool HtmlViewer::writeChunk(const std::string &path, unsigned chunk) const {
+    std::error_code EC;
+    raw_fd_ostream O(path, EC, sys::fs::F_Text);
+    if (EC) {
+        llvm::errs() << "Error: " << EC.message() << "\n";
+        return false;
+    }
+
+    O << "CallGraphViewer.chunk(" << chunk << ",[";
+    size_t end = std::min<size_t>(Nodes.size(), (chunk + 1) * ChunkSize);
+    for (size_t i = chunk * ChunkSize; i < end; ++i) {
+        O << (i % ChunkSize ? ",\n[" : "\n[");
+        writeIDs(O, Nodes[i].Callees);
+        O << ',';
+        writeIDs(O, Nodes[i].Callers);
+        O << ']';
+    }
+    O << "]);\n";
+    return true;
+}
+
+bool HtmlViewer::write(const std::string &path) const {
+    StringRef stem = StringRef(path).endswith(".html") ? StringRef(path).drop_back(5) : StringRef(path);
+    std::string dataDir = stem.str() + "_data";
+    if (std::error_code EC = sys::fs::create_directories(dataDir)) {
+        llvm::errs() << "Error: " << dataDir << ": " << EC.message() << "\n";
+        return false;
+    }
+
+    if (!writeIndex(dataDir + "/index.js")) {
+        return false;
+    }
+    unsigned chunks = (Nodes.size() + ChunkSize - 1) / ChunkSize;
+    for (unsigned chunk = 0; chunk < chunks; ++chunk) {
+        if (!writeChunk(dataDir + "/chunk" + std::to_string(chunk) + ".js", chunk)) {
+            return false;
+        }
+    }
+
+    // The page refers to the data folder relative to itself
+    std::string dataName;
+    raw_string_ostream dataString(dataName);
+    writeJSONString(dataString, sys::path::filename(dataDir));
+
+    std::string page = PageTemplate;
+    replaceAll(page, "@TITLE@", escapeHtml(Title));
+    replaceAll(page, "@DATA@", dataString.str());
+
+    std::error_code EC;
+    raw_fd_ostream O(path, EC, sys::fs::F_Text);
+    if (EC) {
+        llvm::errs() << "Error: " << EC.message() << "\n";
+        return false;
+    }
+    O << page;
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef LIBTOOLING_HTMLVIEWER_H
+#define LIBTOOLING_HTMLVIEWER_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace clang {
+    /// \brief Writes a graph as a local HTML page that shows the calls of a
+    /// function only when they are expanded.
+    ///
+    /// Next to `Foo.m.html` goes a `Foo.m_data` folder: index.js has the names
+    /// of all nodes for the search, and every chunkN.js has the callees and
+    /// callers of ChunkSize nodes, loaded when one of them is expanded. The data
+    /// files are scripts calling back into the page, so the viewer works from
+    /// file:// where browsers refuse to read local files. Nothing is laid out
+    /// up front, calls are shown as trees, so large graphs open immediately.
+    class HtmlViewer {
+    public:
+        /// Nodes per chunk file
+        static const unsigned ChunkSize = 256;
+
+        explicit HtmlViewer(std::string title) : Title(title) {}
+
+        /// \brief Add a node, IDs are given in order starting from 0.
+        unsigned addNode(llvm::StringRef name, llvm::StringRef kind, llvm::StringRef file, unsigned line);
+
+        void addEdge(unsigned caller, unsigned callee);
+
+        /// \brief Write the page to `path` and the data next to it.
+        bool write(const std::string &path) const;
+
+    private:
+        struct Node {
+            std::string Name;
+            std::string Kind;
+            unsigned File;
+            unsigned Line;
+            std::vector<unsigned> Callees;
+            std::vector<unsigned> Callers;
+        };
+
+        bool writeIndex(const std::string &path) const;
+        bool writeChunk(const std::string &path, unsigned chunk) const;
+
+        std::string Title;
+        std::vector<Node> Nodes;
+        std::vector<std::string> Files;
+        llvm::StringMap<unsigned> FileIDs;
+    };
+}
+
+#endif //LIBTOOLING_HTMLVIEWER_H
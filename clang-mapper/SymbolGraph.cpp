@@ -0,0 +1,268 @@
+#include "SymbolGraph.h"
+#include "GraphArchive.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace clang;
+using namespace llvm;
+
+/// Read a node identifier such as `Node0x7f8a1c` or `Node12`, ignoring an
+/// optional record port suffix (`Node12:s0`).
+static StringRef takeNodeID(StringRef &line) {
+    size_t end = line.find_first_of(" \t[:;");
+    StringRef ID = line.substr(0, end);
+    line = line.substr(ID.size());
+    if (line.startswith(":")) {
+        line = line.drop_front().ltrim("abcdefghijklmnopqrstuvwxyz0123456789");
+    }
+    line = line.ltrim();
+    return ID;
+}
+
+/// Decode a quoted attribute, undoing DOT::EscapeString. Only the first field
+/// of a record label is read.
+static std::string parseAttribute(StringRef attrs, StringRef attr) {
+    size_t pos = attrs.find((attr + "=\"").str());
+    if (pos == StringRef::npos) {
+        return "";
+    }
+    StringRef value = attrs.substr(pos + attr.size() + 2);
+    bool isLabel = attr == "label";
+    if (isLabel && value.startswith("{")) {
+        value = value.drop_front();
+    }
+
+    std::string name;
+    for (size_t i = 0; i < value.size(); ++i) {
+        char c = value[i];
+        if (c == '\\' && i + 1 < value.size()) {
+            name.push_back(value[++i]);
+        } else if (c == '"' || (isLabel && (c == '}' || c == '|'))) {
+            break;
+        } else {
+            name.push_back(c);
+        }
+    }
+    return name;
+}
+
+/// The symbol of a node: its qualified name written as the tooltip, or the
+/// label for files written before the tooltip was added.
+static std::string parseSymbol(StringRef attrs) {
+    std::string name = parseAttribute(attrs, "tooltip");
+    return name.empty() ? parseAttribute(attrs, "label") : name;
+}
+
+namespace {
+    /// Nodes and edges of one .dot file, with file local node indices
+    struct ParsedDotFile {
+        std::vector<std::string> Symbols;
+        std::vector<std::pair<unsigned, unsigned>> Edges;
+        bool Success = false;
+    };
+}
+
+static void parseDot(StringRef content, ParsedDotFile &result) {
+    // Node identifiers are only meaningful inside one file, and GraphWriter
+    // may emit an edge before its target node, so resolve edges at the end.
+    StringMap<unsigned> localNodes;
+    std::vector<std::pair<StringRef, StringRef>> localEdges;
+
+    while (!content.empty()) {
+        std::pair<StringRef, StringRef> lines = content.split('\n');
+        StringRef line = lines.first.trim();
+        content = lines.second;
+
+        if (!line.startswith("Node")) {
+            continue;
+        }
+
+        StringRef source = takeNodeID(line);
+        if (line.startswith("->")) {
+            line = line.drop_front(2).ltrim();
+            StringRef target = takeNodeID(line);
+            localEdges.push_back(std::make_pair(source, target));
+        } else {
+            localNodes[source] = result.Symbols.size();
+            result.Symbols.push_back(parseSymbol(line));
+        }
+    }
+
+    for (auto &edge : localEdges) {
+        auto caller = localNodes.find(edge.first);
+        auto callee = localNodes.find(edge.second);
+        if (caller != localNodes.end() && callee != localNodes.end()) {
+            result.Edges.push_back(std::make_pair(caller->second, callee->second));
+        }
+    }
+    result.Success = true;
+}
+
+static void parseDotFile(const std::string &path, ParsedDotFile &result) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+    if (!buffer) {
+        llvm::errs() << "Error: " << path << ": " << buffer.getError().message() << "\n";
+        return;
+    }
+    parseDot((*buffer)->getBuffer(), result);
+}
+
+static void parseArchiveEntry(const GraphArchiveReader &reader, const GraphArchiveEntry &entry,
+                              ParsedDotFile &result) {
+    std::string content;
+    if (reader.extract(entry, content)) {
+        parseDot(content, result);
+    }
+}
+
+static void mergeDotFile(SymbolGraph &graph, const ParsedDotFile &file) {
+    std::vector<SymbolGraph::SymbolID> IDs(file.Symbols.size());
+    for (size_t i = 0; i < file.Symbols.size(); ++i) {
+        IDs[i] = graph.addSymbol(file.Symbols[i]);
+    }
+    for (auto &edge : file.Edges) {
+        graph.addEdge(IDs[edge.first], IDs[edge.second]);
+    }
+}
+
+bool SymbolGraph::loadPath(const std::string &path, unsigned jobs) {
+    if (GraphArchiveReader::isArchive(path)) {
+        return loadArchive(path, jobs);
+    }
+    if (!sys::fs::is_directory(path)) {
+        return loadDotFile(path);
+    }
+
+    std::vector<std::string> files;
+    std::error_code code;
+    sys::fs::recursive_directory_iterator end;
+    for (auto it = sys::fs::recursive_directory_iterator(path, code); it != end; it.increment(code)) {
+        if (code) {
+            llvm::errs() << "Error: " << code.message() << "\n";
+            return false;
+        }
+        if (StringRef((*it).path()).endswith(".dot")) {
+            files.push_back((*it).path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<ParsedDotFile> parsed(files.size());
+    if (jobs > 1 && files.size() > 1) {
+        ThreadPool pool(jobs);
+        for (size_t i = 0; i < files.size(); ++i) {
+            pool.async([&files, &parsed, i] { parseDotFile(files[i], parsed[i]); });
+        }
+        pool.wait();
+    } else {
+        for (size_t i = 0; i < files.size(); ++i) {
+            parseDotFile(files[i], parsed[i]);
+        }
+    }
+
+    bool success = true;
+    for (const ParsedDotFile &file : parsed) {
+        success &= file.Success;
+        mergeDotFile(*this, file);
+    }
+    return success;
+}
+
+bool SymbolGraph::loadArchive(const std::string &path, unsigned jobs) {
+    GraphArchiveReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+
+    const std::vector<GraphArchiveEntry> &entries = reader.entries();
+    std::vector<ParsedDotFile> parsed(entries.size());
+    if (jobs > 1 && entries.size() > 1) {
+        ThreadPool pool(jobs);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            pool.async([&reader, &entries, &parsed, i] { parseArchiveEntry(reader, entries[i], parsed[i]); });
+        }
+        pool.wait();
+    } else {
+        for (size_t i = 0; i < entries.size(); ++i) {
+            parseArchiveEntry(reader, entries[i], parsed[i]);
+        }
+    }
+
+    bool success = true;
+    for (const ParsedDotFile &file : parsed) {
+        success &= file.Success;
+        mergeDotFile(*this, file);
+    }
+    return success;
+}
+
+bool SymbolGraph::loadDotFile(const std::string &path) {
+    ParsedDotFile file;
+    parseDotFile(path, file);
+    mergeDotFile(*this, file);
+    return file.Success;
+}
+
+SymbolGraph::SymbolID SymbolGraph::addSymbol(StringRef name) {
+    assert(!Finalized && "cannot add symbols after finalize()");
+    auto result = Index.insert(std::make_pair(name, (SymbolID)Names.size()));
+    if (result.second) {
+        Names.push_back(name.str());
+    }
+    return result.first->second;
+}
+
+bool SymbolGraph::lookup(StringRef name, SymbolID &ID) const {
+    auto it = Index.find(name);
+    if (it == Index.end()) {
+        return false;
+    }
+    ID = it->second;
+    return true;
+}
+
+void SymbolGraph::finalize() {
+    // Renumber symbols in name order
+    std::vector<SymbolID> order(Names.size());
+    for (SymbolID i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [this](SymbolID lhs, SymbolID rhs) {
+        return Names[lhs] < Names[rhs];
+    });
+
+    std::vector<SymbolID> remap(Names.size());
+    std::vector<std::string> sortedNames(Names.size());
+    for (SymbolID i = 0; i < order.size(); ++i) {
+        remap[order[i]] = i;
+        sortedNames[i] = std::move(Names[order[i]]);
+        Index[sortedNames[i]] = i;
+    }
+    Names.swap(sortedNames);
+
+    for (Edge &edge : Edges) {
+        edge.first = remap[edge.first];
+        edge.second = remap[edge.second];
+    }
+    std::sort(Edges.begin(), Edges.end());
+    Edges.erase(std::unique(Edges.begin(), Edges.end()), Edges.end());
+
+    // Build the adjacency array
+    Offsets.assign(Names.size() + 1, 0);
+    Targets.resize(Edges.size());
+    for (const Edge &edge : Edges) {
+        ++Offsets[edge.first + 1];
+    }
+    for (size_t i = 1; i < Offsets.size(); ++i) {
+        Offsets[i] += Offsets[i - 1];
+    }
+    for (size_t i = 0; i < Edges.size(); ++i) {
+        Targets[i] = Edges[i].second;
+    }
+
+    Finalized = true;
+}
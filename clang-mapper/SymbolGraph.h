@@ -0,0 +1,83 @@
+#ifndef LIBTOOLING_SYMBOLGRAPH_H
+#define LIBTOOLING_SYMBOLGRAPH_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clang {
+    /// \brief A call graph read back from the output of a previous run.
+    ///
+    /// Unlike CallGraph, which is keyed by the Decls of a live AST, nodes here
+    /// are identified by their qualified name, like `-[Class selector]` or
+    /// `ns::function`, so graphs from several files (or from two revisions of
+    /// the same project) can be merged and compared.
+    /// After finalize() the symbol IDs are sorted by name and the callees of
+    /// every node are stored in one sorted adjacency array.
+    class SymbolGraph {
+    public:
+        typedef unsigned SymbolID;
+        typedef std::pair<SymbolID, SymbolID> Edge;
+
+        SymbolGraph() : Finalized(false) {}
+
+        /// \brief Load a .dot file written by clang-mapper, every .dot file
+        /// in a directory, or every entry of a graph archive. Nodes with the
+        /// same name are merged.
+        ///
+        /// Files are parsed on `jobs` threads and merged in path order, so the
+        /// result doesn't depend on the number of threads.
+        bool loadPath(const std::string &path, unsigned jobs = 1);
+
+        /// \brief Load a single .dot file.
+        bool loadDotFile(const std::string &path);
+
+        /// \brief Load every entry of a graph archive written with `-archive`.
+        bool loadArchive(const std::string &path, unsigned jobs = 1);
+
+        /// \brief Intern a symbol name, returning its ID.
+        SymbolID addSymbol(llvm::StringRef name);
+
+        void addEdge(SymbolID caller, SymbolID callee) {
+            Edges.push_back(Edge(caller, callee));
+        }
+
+        /// \brief Sort the symbols by name and the edges by (caller, callee),
+        /// dropping duplicate edges. IDs handed out before are invalidated.
+        void finalize();
+
+        bool isFinalized() const { return Finalized; }
+
+        /// \brief Get the number of nodes in the graph.
+        unsigned size() const { return Names.size(); }
+
+        llvm::StringRef getName(SymbolID ID) const { return Names[ID]; }
+
+        /// \brief Lookup a symbol by name, return false if it isn't in the graph.
+        bool lookup(llvm::StringRef name, SymbolID &ID) const;
+
+        /// All edges sorted by (caller, callee), only valid after finalize().
+        const std::vector<Edge> &edges() const { return Edges; }
+
+        /// Callees of the given node in ascending order, only valid after finalize().
+        llvm::ArrayRef<SymbolID> callees(SymbolID ID) const {
+            return llvm::makeArrayRef(Targets).slice(Offsets[ID], Offsets[ID + 1] - Offsets[ID]);
+        }
+
+    private:
+        std::vector<std::string> Names;
+        llvm::StringMap<SymbolID> Index;
+        std::vector<Edge> Edges;
+
+        /// Compressed adjacency: callees of node N are Targets[Offsets[N], Offsets[N+1])
+        std::vector<unsigned> Offsets;
+        std::vector<SymbolID> Targets;
+
+        bool Finalized;
+    };
+}
+
+#endif //LIBTOOLING_SYMBOLGRAPH_H
@@ -0,0 +1,114 @@
+#include "TimingDatabase.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace clang;
+using namespace llvm;
+
+bool TimingDatabase::load(const std::string &path) {
+    if (!sys::fs::exists(path)) {
+        return true;
+    }
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+    if (!buffer) {
+        llvm::errs() << "Error: " << path << ": " << buffer.getError().message() << "\n";
+        return false;
+    }
+
+    SmallVector<StringRef, 4> fields;
+    StringRef content = (*buffer)->getBuffer();
+    while (!content.empty()) {
+        std::pair<StringRef, StringRef> lines = content.split('\n');
+        content = lines.second;
+
+        fields.clear();
+        lines.first.split(fields, '\t', 3);
+        if (fields.size() != 4) {
+            continue;
+        }
+
+        Entry entry;
+        entry.ParseMs = std::strtod(fields[0].str().c_str(), nullptr);
+        entry.RenderMs = std::strtod(fields[1].str().c_str(), nullptr);
+        if (fields[2].getAsInteger(10, entry.Size)) {
+            continue;
+        }
+        Entries[fields[3]] = entry;
+    }
+    return true;
+}
+
+bool TimingDatabase::save(const std::string &path) const {
+    std::error_code EC;
+    raw_fd_ostream O(path, EC, sys::fs::F_Text);
+    if (EC) {
+        llvm::errs() << "Error: " << EC.message() << "\n";
+        return false;
+    }
+
+    // Keep the file stable between runs
+    std::vector<StringRef> files;
+    for (auto &entry : Entries) {
+        files.push_back(entry.getKey());
+    }
+    std::sort(files.begin(), files.end());
+
+    for (StringRef file : files) {
+        const Entry &entry = Entries.find(file)->second;
+        O << format("%.1f\t%.1f\t", entry.ParseMs, entry.RenderMs) << entry.Size << "\t" << file << "\n";
+    }
+    return true;
+}
+
+void TimingDatabase::record(StringRef file, double parseMs, double renderMs) {
+    uint64_t size = 0;
+    sys::fs::file_size(file, size);
+    Entries[file] = {parseMs, renderMs, size};
+}
+
+double TimingDatabase::estimate(StringRef file) const {
+    return estimate(file, averageMsPerByte());
+}
+
+double TimingDatabase::estimate(StringRef file, double msPerByte) const {
+    auto it = Entries.find(file);
+    if (it != Entries.end()) {
+        return it->second.ParseMs + it->second.RenderMs;
+    }
+
+    uint64_t size = 0;
+    sys::fs::file_size(file, size);
+    return size * msPerByte;
+}
+
+double TimingDatabase::averageMsPerByte() const {
+    double totalMs = 0;
+    double totalBytes = 0;
+    for (auto &entry : Entries) {
+        totalMs += entry.getValue().ParseMs + entry.getValue().RenderMs;
+        totalBytes += entry.getValue().Size;
+    }
+    return (totalMs > 0 && totalBytes > 0) ? totalMs / totalBytes : 1.0;
+}
+
+void TimingDatabase::sortLongestFirst(std::vector<std::string> &files) const {
+    double msPerByte = averageMsPerByte();
+    std::vector<std::pair<double, std::string>> costs;
+    costs.reserve(files.size());
+    for (std::string &file : files) {
+        costs.push_back(std::make_pair(estimate(file, msPerByte), std::move(file)));
+    }
+    std::stable_sort(costs.begin(), costs.end(),
+                     [](const std::pair<double, std::string> &lhs, const std::pair<double, std::string> &rhs) {
+                         return lhs.first > rhs.first;
+                     });
+    for (size_t i = 0; i < files.size(); ++i) {
+        files[i] = std::move(costs[i].second);
+    }
+}
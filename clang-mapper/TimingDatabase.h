@@ -0,0 +1,51 @@
+#ifndef LIBTOOLING_TIMINGDATABASE_H
+#define LIBTOOLING_TIMINGDATABASE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace clang {
+    /// \brief Parse and render durations of every file from previous runs.
+    ///
+    /// Used to start the most expensive files first, so a few slow files
+    /// scheduled last don't dominate a parallel run. The database is a text
+    /// file with one "parse_ms<TAB>render_ms<TAB>size<TAB>path" line per file.
+    class TimingDatabase {
+    public:
+        struct Entry {
+            double ParseMs;
+            double RenderMs;
+            uint64_t Size;
+        };
+
+        /// \brief Merge the entries of `path` into the database. A missing
+        /// file is not an error, newer entries replace older ones.
+        bool load(const std::string &path);
+
+        bool save(const std::string &path) const;
+
+        void record(llvm::StringRef file, double parseMs, double renderMs);
+
+        /// \brief Estimated milliseconds for `file`. Files without history are
+        /// estimated from their size and the average speed of the known files.
+        double estimate(llvm::StringRef file) const;
+
+        /// \brief Sort `files` by estimated duration, longest first.
+        void sortLongestFirst(std::vector<std::string> &files) const;
+
+        bool empty() const { return Entries.empty(); }
+
+    private:
+        double estimate(llvm::StringRef file, double msPerByte) const;
+
+        /// Average cost of the known files, 1 if there's no history yet
+        double averageMsPerByte() const;
+
+        llvm::StringMap<Entry> Entries;
+    };
+}
+
+#endif //LIBTOOLING_TIMINGDATABASE_H
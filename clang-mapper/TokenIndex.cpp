@@ -0,0 +1,236 @@
+#include "TokenIndex.h"
+
+#include "clang/Basic/LangOptions.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace clang;
+using namespace llvm;
+
+/// Return the identifiers of a file, sorted and unique
+static std::vector<std::string> lexIdentifiers(const std::string &path) {
+    std::vector<std::string> identifiers;
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+    if (!buffer) {
+        return identifiers;
+    }
+
+    // Accept the keywords and literals of every language we parse
+    LangOptions langOpts;
+    langOpts.ObjC1 = 1;
+    langOpts.ObjC2 = 1;
+    langOpts.CPlusPlus = 1;
+    langOpts.CPlusPlus11 = 1;
+
+    StringRef content = (*buffer)->getBuffer();
+    Lexer lexer(SourceLocation(), langOpts, content.begin(), content.begin(), content.end());
+    Token token;
+    for (lexer.LexFromRawLexer(token); token.isNot(tok::eof); lexer.LexFromRawLexer(token)) {
+        if (token.is(tok::raw_identifier)) {
+            identifiers.push_back(token.getRawIdentifier().str());
+        }
+    }
+
+    std::sort(identifiers.begin(), identifiers.end());
+    identifiers.erase(std::unique(identifiers.begin(), identifiers.end()), identifiers.end());
+    return identifiers;
+}
+
+/// Strip the class of `-[Class selector]` and the scope of `ns::function`
+static StringRef getUnqualifiedName(StringRef symbol) {
+    if ((symbol.startswith("-[") || symbol.startswith("+[")) && symbol.endswith("]")) {
+        return symbol.drop_front(2).drop_back().split(' ').second;
+    }
+    size_t scope = symbol.rfind("::");
+    if (scope != StringRef::npos) {
+        return symbol.substr(scope + 2);
+    }
+    return symbol;
+}
+
+/// Get the identifiers a file mentioning `symbol` has to contain
+static void getSymbolPieces(StringRef symbol, SmallVectorImpl<StringRef> &pieces) {
+    getUnqualifiedName(symbol).split(pieces, ':', -1, false);
+}
+
+static bool getFileStatus(StringRef path, uint64_t &modificationTime, uint64_t &size) {
+    sys::fs::file_status status;
+    if (sys::fs::status(path, status)) {
+        return false;
+    }
+    modificationTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            status.getLastModificationTime().time_since_epoch()).count();
+    size = status.getSize();
+    return true;
+}
+
+bool TokenIndex::load(const std::string &path) {
+    if (!sys::fs::exists(path)) {
+        return true;
+    }
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+    if (!buffer) {
+        llvm::errs() << "Error: " << path << ": " << buffer.getError().message() << "\n";
+        return false;
+    }
+
+    SmallVector<StringRef, 4> fields;
+    SmallVector<StringRef, 256> identifiers;
+    StringRef content = (*buffer)->getBuffer();
+    while (!content.empty()) {
+        std::pair<StringRef, StringRef> header = content.split('\n');
+        std::pair<StringRef, StringRef> body = header.second.split('\n');
+        content = body.second;
+
+        fields.clear();
+        header.first.split(fields, '\t', 2);
+        Entry entry;
+        if (fields.size() != 3 || fields[0].getAsInteger(10, entry.ModificationTime) ||
+            fields[1].getAsInteger(10, entry.Size)) {
+            continue;
+        }
+
+        identifiers.clear();
+        body.first.split(identifiers, ' ', -1, false);
+        entry.Identifiers.assign(identifiers.begin(), identifiers.end());
+        Entries[fields[2]] = std::move(entry);
+    }
+    return true;
+}
+
+bool TokenIndex::save(const std::string &path) const {
+    std::error_code EC;
+    raw_fd_ostream O(path, EC, sys::fs::F_Text);
+    if (EC) {
+        llvm::errs() << "Error: " << EC.message() << "\n";
+        return false;
+    }
+
+    // Keep the file stable between runs
+    std::vector<StringRef> files;
+    for (auto &entry : Entries) {
+        files.push_back(entry.getKey());
+    }
+    std::sort(files.begin(), files.end());
+
+    for (StringRef file : files) {
+        const Entry &entry = Entries.find(file)->second;
+        O << entry.ModificationTime << "\t" << entry.Size << "\t" << file << "\n";
+        for (size_t i = 0; i < entry.Identifiers.size(); ++i) {
+            O << (i ? " " : "") << entry.Identifiers[i];
+        }
+        O << "\n";
+    }
+    return true;
+}
+
+void TokenIndex::update(const std::vector<std::string> &files, unsigned jobs) {
+    struct Stale {
+        std::string File;
+        Entry Lexed;
+    };
+
+    std::vector<Stale> stale;
+    for (const std::string &file : files) {
+        Entry current;
+        if (!getFileStatus(file, current.ModificationTime, current.Size)) {
+            continue;
+        }
+        auto it = Entries.find(file);
+        if (it == Entries.end() || it->second.ModificationTime != current.ModificationTime ||
+            it->second.Size != current.Size) {
+            stale.push_back({file, std::move(current)});
+        }
+    }
+
+    // Every task writes its own slot
+    if (!stale.empty()) {
+        ThreadPool pool(jobs);
+        for (Stale &item : stale) {
+            pool.async([&item] { item.Lexed.Identifiers = lexIdentifiers(item.File); });
+        }
+        pool.wait();
+    }
+    for (Stale &item : stale) {
+        Entries[item.File] = std::move(item.Lexed);
+    }
+
+    Files.clear();
+    Postings.clear();
+    for (const std::string &file : files) {
+        auto it = Entries.find(file);
+        if (it == Entries.end()) {
+            continue;
+        }
+        for (const std::string &identifier : it->second.Identifiers) {
+            Postings[identifier].push_back(Files.size());
+        }
+        Files.push_back(file);
+    }
+}
+
+std::vector<std::string> TokenIndex::filesMentioning(StringRef symbol) const {
+    std::vector<std::string> files;
+    SmallVector<StringRef, 4> pieces;
+    getSymbolPieces(symbol, pieces);
+    if (pieces.empty()) {
+        return files;
+    }
+
+    // Intersect the sorted postings of all pieces
+    std::vector<unsigned> matched;
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        auto it = Postings.find(pieces[i]);
+        if (it == Postings.end()) {
+            return files;
+        }
+        if (i == 0) {
+            matched.assign(it->second.begin(), it->second.end());
+            continue;
+        }
+        std::vector<unsigned> intersection;
+        std::set_intersection(matched.begin(), matched.end(), it->second.begin(), it->second.end(),
+                              std::back_inserter(intersection));
+        matched.swap(intersection);
+    }
+
+    for (unsigned file : matched) {
+        files.push_back(Files[file]);
+    }
+    return files;
+}
+
+std::string FocusGraph::getName(StringRef symbol) {
+    return getUnqualifiedName(symbol).str();
+}
+
+void FocusGraph::addCall(StringRef caller, StringRef callee) {
+    if (caller.empty() || callee.empty()) {
+        return;
+    }
+    Neighbors[caller].insert(callee);
+    Neighbors[callee].insert(caller);
+}
+
+std::vector<std::string> FocusGraph::expand(const std::vector<std::string> &names, StringSet<> &known) const {
+    std::vector<std::string> found;
+    for (const std::string &name : names) {
+        auto it = Neighbors.find(name);
+        if (it == Neighbors.end()) {
+            continue;
+        }
+        for (auto &neighbor : it->second) {
+            if (known.insert(neighbor.getKey()).second) {
+                found.push_back(neighbor.getKey().str());
+            }
+        }
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
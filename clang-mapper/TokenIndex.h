@@ -0,0 +1,74 @@
+#ifndef LIBTOOLING_TOKENINDEX_H
+#define LIBTOOLING_TOKENINDEX_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace clang {
+    /// \brief Identifiers of every source file, found by the raw lexer.
+    ///
+    /// Lexing without preprocessing is much cheaper than parsing, so the index
+    /// tells which files can mention a symbol before any of them is parsed.
+    /// It's saved as a text file with a "mtime<TAB>size<TAB>path" line per file
+    /// followed by a line with its identifiers, files that didn't change since
+    /// are not lexed again.
+    class TokenIndex {
+    public:
+        /// \brief Merge the entries of `path`. A missing file is not an error.
+        bool load(const std::string &path);
+
+        bool save(const std::string &path) const;
+
+        /// \brief Lex the files which are new or changed on `jobs` threads, and
+        /// make `files` the files searched by filesMentioning().
+        void update(const std::vector<std::string> &files, unsigned jobs);
+
+        /// \brief Files mentioning every identifier of `symbol`, in the order
+        /// given to update().
+        ///
+        /// A selector is looked up by its pieces, `-[Class selector]` by its
+        /// selector and `ns::function` by the last name.
+        std::vector<std::string> filesMentioning(llvm::StringRef symbol) const;
+
+    private:
+        struct Entry {
+            uint64_t ModificationTime;
+            uint64_t Size;
+
+            /// Sorted and unique
+            std::vector<std::string> Identifiers;
+        };
+
+        llvm::StringMap<Entry> Entries;
+
+        /// The files of the last update() and which of them have each identifier
+        std::vector<std::string> Files;
+        llvm::StringMap<llvm::SmallVector<unsigned, 4>> Postings;
+    };
+
+    /// \brief Callers and callees by name, collected from the files parsed for
+    /// `-focus` to find the symbols of the next round.
+    class FocusGraph {
+    public:
+        /// \brief The name `symbol` is recorded under, which is the name of
+        /// the declaration: the selector of `-[Class selector]` and the last
+        /// name of `ns::function`.
+        static std::string getName(llvm::StringRef symbol);
+
+        void addCall(llvm::StringRef caller, llvm::StringRef callee);
+
+        /// \brief The callers and callees of `names` which aren't in `known`
+        /// yet, they are added to `known`.
+        std::vector<std::string> expand(const std::vector<std::string> &names, llvm::StringSet<> &known) const;
+
+    private:
+        llvm::StringMap<llvm::StringSet<>> Neighbors;
+    };
+}
+
+#endif //LIBTOOLING_TOKENINDEX_H
@@ -0,0 +1,233 @@
+#include "WorkerPool.h"
+#include "GraphArchive.h"
+#include "TimingDatabase.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <signal.h>
+#include <thread>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <libproc.h>
+#endif
+
+using namespace clang;
+using namespace llvm;
+
+namespace {
+    struct RunningWorker {
+        sys::ProcessInfo Process;
+        std::string File;
+        std::chrono::steady_clock::time_point Start;
+
+        /// Where the worker writes its timings, empty if not collected
+        std::string TimingFile;
+
+        /// Where the stdout of the worker goes, empty if not captured
+        std::string OutputFile;
+
+        /// Archive of the worker, empty if not archiving
+        std::string ArchiveFile;
+    };
+
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+}
+
+/// Copy the captured stdout of a worker to our stdout
+static void forwardOutput(const std::string &path) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(path);
+    if (!buffer) {
+        llvm::errs() << "Error: " << path << ": " << buffer.getError().message() << "\n";
+        return;
+    }
+    llvm::outs() << (*buffer)->getBuffer();
+    llvm::outs().flush();
+}
+
+/// Resident memory of a process in bytes, 0 if it can't be read
+static uint64_t getResidentMemory(int pid) {
+#if defined(__APPLE__)
+    struct proc_taskinfo info;
+    if (proc_pidinfo(pid, PROC_PIDTASKINFO, 0, &info, sizeof(info)) != sizeof(info)) {
+        return 0;
+    }
+    return info.pti_resident_size;
+#elif defined(__linux__)
+    // The second field of statm is the resident set in pages
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer =
+            MemoryBuffer::getFileAsStream("/proc/" + std::to_string(pid) + "/statm");
+    uint64_t pages = 0;
+    if (!buffer || (*buffer)->getBuffer().split(' ').second.split(' ').first.getAsInteger(10, pages)) {
+        return 0;
+    }
+    return pages * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+WorkerPool::WorkerPool(std::string executable, std::vector<std::string> workerArgs,
+                       size_t fileArgIndex, unsigned jobs)
+        : Executable(executable), WorkerArgs(workerArgs), FileArgIndex(fileArgIndex),
+          Jobs(jobs ? jobs : 1), Timeout(0), MemoryLimit(0), Timings(nullptr),
+          CaptureOutput(false), Archive(nullptr) {}
+
+bool WorkerPool::run(const std::vector<std::string> &files) {
+    std::vector<RunningWorker> running;
+    std::vector<std::pair<std::string, std::string>> archives; // (file, archive)
+    size_t next = 0;
+
+    while (next < files.size() || !running.empty()) {
+        // Keep every slot busy
+        while (running.size() < Jobs && next < files.size()) {
+            const std::string &file = files[next++];
+
+            SmallString<128> timingFile;
+            std::string timingArg;
+            if (Timings && !sys::fs::createTemporaryFile("clang-mapper-timing", "txt", timingFile)) {
+                timingArg = "-timing-out=" + timingFile.str().str();
+            }
+
+            SmallString<128> archiveFile;
+            std::string archiveArg;
+            if (Archive && !sys::fs::createTemporaryFile("clang-mapper-graphs", "cmga", archiveFile)) {
+                archiveArg = "-archive=" + archiveFile.str().str();
+            }
+
+            std::vector<const char *> args;
+            args.push_back(Executable.c_str());
+            if (!timingArg.empty()) {
+                args.push_back(timingArg.c_str());
+            }
+            if (!archiveArg.empty()) {
+                args.push_back(archiveArg.c_str());
+            }
+            for (size_t i = 0; i < WorkerArgs.size(); ++i) {
+                if (i == FileArgIndex) {
+                    args.push_back(file.c_str());
+                }
+                args.push_back(WorkerArgs[i].c_str());
+            }
+            if (FileArgIndex >= WorkerArgs.size()) {
+                args.push_back(file.c_str());
+            }
+            args.push_back(nullptr);
+
+            SmallString<128> outputFile;
+            StringRef outputRedirect;
+            const StringRef *redirects[] = {nullptr, &outputRedirect, nullptr};
+            if (CaptureOutput && !sys::fs::createTemporaryFile("clang-mapper-output", "txt", outputFile)) {
+                outputRedirect = outputFile;
+            }
+
+            std::string ErrMsg;
+            bool failed = false;
+            sys::ProcessInfo PI = sys::ExecuteNoWait(Executable, args.data(), nullptr,
+                                                     outputRedirect.empty() ? nullptr : redirects,
+                                                     0, &ErrMsg, &failed);
+            if (failed) {
+                Failures.push_back({file, "spawn failed: " + ErrMsg});
+                if (!timingArg.empty()) {
+                    sys::fs::remove(timingFile);
+                }
+                if (!outputRedirect.empty()) {
+                    sys::fs::remove(outputFile);
+                }
+                if (!archiveArg.empty()) {
+                    sys::fs::remove(archiveFile);
+                }
+                continue;
+            }
+            running.push_back({PI, file, std::chrono::steady_clock::now(),
+                               timingFile.str().str(), outputFile.str().str(), archiveFile.str().str()});
+        }
+
+        bool finishedAny = false;
+        for (auto it = running.begin(); it != running.end();) {
+            std::string ErrMsg;
+            std::string failure;
+            sys::ProcessInfo result = sys::Wait(it->Process, 0, false, &ErrMsg);
+            auto elapsed = std::chrono::steady_clock::now() - it->Start;
+
+            if (result.Pid == it->Process.Pid) {
+                if (result.ReturnCode == -2) {
+                    failure = "crashed: " + ErrMsg;
+                } else if (result.ReturnCode != 0) {
+                    failure = "exit code " + std::to_string(result.ReturnCode);
+                }
+            } else if (Timeout && elapsed > std::chrono::seconds(Timeout)) {
+                ::kill(it->Process.Pid, SIGKILL);
+                sys::Wait(it->Process, 0, true, &ErrMsg);
+                failure = "timeout after " + std::to_string(Timeout) + "s";
+            } else if (MemoryLimit && getResidentMemory(it->Process.Pid) > ((uint64_t)MemoryLimit << 20)) {
+                ::kill(it->Process.Pid, SIGKILL);
+                sys::Wait(it->Process, 0, true, &ErrMsg);
+                failure = "memory limit of " + std::to_string(MemoryLimit) + " MB exceeded";
+            } else {
+                ++it;
+                continue;
+            }
+
+            if (!failure.empty()) {
+                Failures.push_back({it->File, failure});
+            }
+            if (!it->TimingFile.empty()) {
+                if (failure.empty()) {
+                    Timings->load(it->TimingFile);
+                } else {
+                    Timings->record(it->File, Milliseconds(elapsed).count(), 0);
+                }
+                sys::fs::remove(it->TimingFile);
+            }
+            if (!it->OutputFile.empty()) {
+                if (failure.empty()) {
+                    forwardOutput(it->OutputFile);
+                }
+                sys::fs::remove(it->OutputFile);
+            }
+            if (!it->ArchiveFile.empty()) {
+                if (failure.empty()) {
+                    archives.push_back(std::make_pair(it->File, it->ArchiveFile));
+                } else {
+                    sys::fs::remove(it->ArchiveFile);
+                }
+            }
+            it = running.erase(it);
+            finishedAny = true;
+        }
+
+        if (!finishedAny) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+
+    // Workers finish in any order, merge by file so every run and every -j
+    // writes the same archive
+    std::sort(archives.begin(), archives.end());
+    for (auto &archive : archives) {
+        Archive->addArchive(archive.second);
+        sys::fs::remove(archive.second);
+    }
+
+    for (const Failure &failure : Failures) {
+        llvm::errs() << "Skipped " << failure.File << ": " << failure.Reason << "\n";
+    }
+    return Failures.empty();
+}
+
+void WorkerPool::writeFailures(const std::string &path) const {
+    std::error_code EC;
+    raw_fd_ostream O(path, EC, sys::fs::F_Text);
+    if (EC) {
+        llvm::errs() << "Error: " << EC.message() << "\n";
+        return;
+    }
+    for (const Failure &failure : Failures) {
+        O << failure.Reason << "\t" << failure.File << "\n";
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef LIBTOOLING_WORKERPOOL_H
+#define LIBTOOLING_WORKERPOOL_H
+
+#include <string>
+#include <vector>
+
+namespace clang {
+    class TimingDatabase;
+    class GraphArchiveWriter;
+
+    /// \brief Supervises a set of clang-mapper worker processes.
+    ///
+    /// Every source file is handed to a fresh worker process, so a file that
+    /// crashes the parser, hangs, or runs out of memory only loses itself: the
+    /// worker is killed, the file is recorded as failed and the next file is
+    /// started in a new worker.
+    class WorkerPool {
+    public:
+        struct Failure {
+            std::string File;
+            std::string Reason;
+        };
+
+        /// \param executable path of the clang-mapper binary
+        /// \param workerArgs arguments for each worker, `fileArgIndex` marks
+        /// where the source file is inserted
+        WorkerPool(std::string executable, std::vector<std::string> workerArgs,
+                   size_t fileArgIndex, unsigned jobs);
+
+        /// Kill a worker after it runs `seconds` on one file, 0 means no limit
+        void setTimeout(unsigned seconds) { Timeout = seconds; }
+
+        /// Kill a worker whose resident memory exceeds `megabytes`, 0 means
+        /// no limit. Rlimits aren't enforced for malloc on Darwin, so the
+        /// memory is polled like the timeout.
+        void setMemoryLimit(unsigned megabytes) { MemoryLimit = megabytes; }
+
+        /// Collect the timings reported by the workers. A failed file is
+        /// recorded with the time it ran, so it's started early next time.
+        void setTimingDatabase(TimingDatabase *timings) { Timings = timings; }
+
+        /// Buffer the stdout of every worker and copy it to our stdout when the
+        /// worker succeeds, so the output of workers never interleaves and a
+        /// crashed worker leaves no partial records.
+        void setCaptureOutput(bool capture) { CaptureOutput = capture; }
+
+        /// Let every worker write its own archive and merge the archives of
+        /// the workers that succeeded into `archive`, in file order, when all
+        /// files are done.
+        void setArchive(GraphArchiveWriter *archive) { Archive = archive; }
+
+        /// \brief Process all files, return false if any of them failed.
+        bool run(const std::vector<std::string> &files);
+
+        const std::vector<Failure> &failures() const { return Failures; }
+
+        /// \brief Write the failed files to `path`, one "reason<TAB>file" per line.
+        void writeFailures(const std::string &path) const;
+
+    private:
+        std::string Executable;
+        std::vector<std::string> WorkerArgs;
+        size_t FileArgIndex;
+        unsigned Jobs;
+        unsigned Timeout;
+        unsigned MemoryLimit;
+        TimingDatabase *Timings;
+        bool CaptureOutput;
+        GraphArchiveWriter *Archive;
+        std::vector<Failure> Failures;
+    };
+}
+
+#endif //LIBTOOLING_WORKERPOOL_H